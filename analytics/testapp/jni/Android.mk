@@ -39,6 +39,10 @@ include $(CLEAR_VARS)
 LOCAL_MODULE:=android_main
 LOCAL_SRC_FILES:=\
 	$(LOCAL_PATH)/src/common_main.cc \
+	$(LOCAL_PATH)/src/event_throttle.cc \
+	$(LOCAL_PATH)/src/user_property_cache.cc \
+	$(LOCAL_PATH)/src/analytics_sink.cc \
+	$(LOCAL_PATH)/src/name_validator.cc \
 	$(LOCAL_PATH)/src/android/android_main.cc
 LOCAL_STATIC_LIBRARIES:=\
 	firebase_analytics \
@@ -0,0 +1,107 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "analytics_sink.h"  // NOLINT
+
+#include <atomic>
+#include <chrono>
+
+namespace {
+
+std::atomic<LocalAnalyticsSink*> g_installed_sink(nullptr);
+
+}  // namespace
+
+namespace analytics_sink {
+
+void LogEvent(const char* name,
+              const ::firebase::analytics::Parameter* parameters,
+              size_t number_of_parameters) {
+  LocalAnalyticsSink* sink = g_installed_sink.load();
+  if (sink) {
+    sink->Receive(LocalAnalyticsSink::kCallTypeLogEvent, number_of_parameters);
+  } else if (number_of_parameters == 0) {
+    ::firebase::analytics::LogEvent(name);
+  } else {
+    ::firebase::analytics::LogEvent(name, parameters, number_of_parameters);
+  }
+}
+
+void SetUserProperty(const char* name, const char* property) {
+  LocalAnalyticsSink* sink = g_installed_sink.load();
+  if (sink) {
+    sink->Receive(LocalAnalyticsSink::kCallTypeSetUserProperty, 0);
+  } else {
+    ::firebase::analytics::SetUserProperty(name, property);
+  }
+}
+
+void SetUserId(const char* user_id) {
+  LocalAnalyticsSink* sink = g_installed_sink.load();
+  if (sink) {
+    sink->Receive(LocalAnalyticsSink::kCallTypeSetUserId, 0);
+  } else {
+    ::firebase::analytics::SetUserId(user_id);
+  }
+}
+
+}  // namespace analytics_sink
+
+LocalAnalyticsSink::LocalAnalyticsSink(size_t expected_calls) {
+  records_.reserve(expected_calls);
+}
+
+LocalAnalyticsSink::~LocalAnalyticsSink() {
+  LocalAnalyticsSink* self = this;
+  g_installed_sink.compare_exchange_strong(self, nullptr);
+}
+
+void LocalAnalyticsSink::Install(LocalAnalyticsSink* sink) {
+  g_installed_sink.store(sink);
+}
+
+LocalAnalyticsSink* LocalAnalyticsSink::installed() {
+  return g_installed_sink.load();
+}
+
+void LocalAnalyticsSink::Receive(CallType type, size_t number_of_parameters) {
+  Record record;
+  record.arrival_ns = NowNanoseconds();
+  record.type = type;
+  record.number_of_parameters = static_cast<uint32_t>(number_of_parameters);
+  std::lock_guard<std::mutex> lock(mutex_);
+  records_.push_back(record);
+}
+
+std::vector<LocalAnalyticsSink::Record> LocalAnalyticsSink::GetRecords()
+    const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return records_;
+}
+
+size_t LocalAnalyticsSink::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return records_.size();
+}
+
+void LocalAnalyticsSink::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  records_.clear();
+}
+
+int64_t LocalAnalyticsSink::NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
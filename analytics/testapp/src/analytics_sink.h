@@ -0,0 +1,89 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_ANALYTICS_SINK_H_  // NOLINT
+#define FIREBASE_TESTAPP_ANALYTICS_SINK_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+#include "firebase/analytics.h"
+
+// Calls the app makes that would be sent to the analytics SDK.
+//
+// Code in this app calls these rather than the SDK directly so that a
+// LocalAnalyticsSink can be installed to measure the app without the live
+// backend.  When no sink is installed each call is forwarded to the SDK.
+namespace analytics_sink {
+
+void LogEvent(const char* name,
+              const ::firebase::analytics::Parameter* parameters,
+              size_t number_of_parameters);
+void SetUserProperty(const char* name, const char* property);
+void SetUserId(const char* user_id);
+
+}  // namespace analytics_sink
+
+// In-process stand-in for the analytics SDK which records the arrival time
+// of each call.
+//
+// Only a fixed size record is kept per call so that the sink itself adds
+// little to the cost being measured.  All methods are thread safe.
+class LocalAnalyticsSink {
+ public:
+  enum CallType {
+    kCallTypeLogEvent,
+    kCallTypeSetUserProperty,
+    kCallTypeSetUserId,
+  };
+
+  struct Record {
+    // Nanoseconds since an arbitrary epoch, from a monotonic clock.
+    int64_t arrival_ns;
+    CallType type;
+    uint32_t number_of_parameters;
+  };
+
+  // Create a sink with room for expected_calls records before it needs to
+  // grow its buffer.
+  explicit LocalAnalyticsSink(size_t expected_calls);
+  ~LocalAnalyticsSink();
+
+  // Route analytics_sink calls to sink, or back to the SDK if sink is null.
+  static void Install(LocalAnalyticsSink* sink);
+  // Get the installed sink, or null if calls go to the SDK.
+  static LocalAnalyticsSink* installed();
+
+  // Record a call of the given type.
+  void Receive(CallType type, size_t number_of_parameters);
+
+  // Copy of all records received so far, in arrival order.
+  std::vector<Record> GetRecords() const;
+  // Number of calls received.
+  size_t size() const;
+  // Discard all records.
+  void Clear();
+
+  // Nanoseconds since the epoch used for Record::arrival_ns.
+  static int64_t NowNanoseconds();
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<Record> records_;
+};
+
+#endif  // FIREBASE_TESTAPP_ANALYTICS_SINK_H_  // NOLINT
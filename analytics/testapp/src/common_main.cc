@@ -18,6 +18,12 @@
 #include "firebase/analytics/user_property_names.h"
 #include "firebase/app.h"
 
+#include "event_throttle.h"  // NOLINT
+#include "user_property_cache.h"  // NOLINT
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+#include "desktop/analytics_benchmark.h"  // NOLINT
+#endif  // !defined(__ANDROID__) && !defined(__APPLE__)
+
 // Thin OS abstraction layer.
 #include "main.h"  // NOLINT
 
@@ -26,6 +32,14 @@ extern "C" int common_main(int argc, const char* argv[]) {
   namespace analytics = ::firebase::analytics;
   ::firebase::App* app;
 
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+  // On desktop the app can measure itself against a local stand-in for the
+  // SDK rather than running the sample.
+  if (AnalyticsBenchmarkRequested(argc, argv)) {
+    return RunAnalyticsBenchmark(argc, argv);
+  }
+#endif  // !defined(__ANDROID__) && !defined(__APPLE__)
+
   LogMessage("Initialize the Analytics library");
   do {
 #if defined(__ANDROID__)
@@ -55,28 +69,43 @@ extern "C" int common_main(int argc, const char* argv[]) {
   analytics::SetSessionTimeoutDuration(5000);
 
   LogMessage("Set user properties.");
+  // User properties are set through a cache which only passes changed values
+  // to the SDK.
+  UserPropertyCache user_properties;
   // Set the user's sign up method.
-  analytics::SetUserProperty(analytics::kUserPropertySignUpMethod, "Google");
+  user_properties.SetUserProperty(analytics::kUserPropertySignUpMethod,
+                                  "Google");
   // Set the user ID.
-  analytics::SetUserId("uber_user_510");
+  user_properties.SetUserId("uber_user_510");
+  // Setting the same values again, as an app might on each screen
+  // transition, doesn't result in calls to the SDK.
+  user_properties.SetUserProperty(analytics::kUserPropertySignUpMethod,
+                                  "Google");
+  user_properties.SetUserId("uber_user_510");
+  LogMessage("User properties forwarded=%d elided=%d",
+             static_cast<int>(user_properties.forwarded_count()),
+             static_cast<int>(user_properties.elided_count()));
+
+  // Events are routed through a throttle so that a bug which logs an event
+  // every frame can't flood the SDK.
+  EventThrottle throttle((EventThrottle::Options()));
 
   // Log an event with no parameters.
   LogMessage("Log login event.");
-  analytics::LogEvent(analytics::kEventLogin);
+  throttle.LogEvent(analytics::kEventLogin);
 
   // Log an event with a floating point parameter.
   LogMessage("Log progress event.");
-  analytics::LogEvent("progress", "percent", 0.4f);
+  throttle.LogEvent("progress", "percent", 0.4f);
 
   // Log an event with an integer parameter.
   LogMessage("Log post score event.");
-  analytics::LogEvent(analytics::kEventPostScore, analytics::kParameterScore,
-                      42);
+  throttle.LogEvent(analytics::kEventPostScore, analytics::kParameterScore, 42);
 
   // Log an event with a string parameter.
   LogMessage("Log group join event.");
-  analytics::LogEvent(analytics::kEventJoinGroup, analytics::kParameterGroupID,
-                      "spoon_welders");
+  throttle.LogEvent(analytics::kEventJoinGroup, analytics::kParameterGroupID,
+                    "spoon_welders");
 
   // Log an event with multiple parameters.
   LogMessage("Log level up event.");
@@ -86,11 +115,19 @@ extern "C" int common_main(int argc, const char* argv[]) {
         analytics::Parameter(analytics::kParameterCharacter, "mrspoon"),
         analytics::Parameter("hit_accuracy", 3.14f),
     };
-    analytics::LogEvent(
+    throttle.LogEvent(
         analytics::kEventLevelUp, kLevelUpParameters,
         sizeof(kLevelUpParameters) / sizeof(kLevelUpParameters[0]));
   }
 
+  // Log the same event in a tight loop, as a bug in a frame loop might.  Most
+  // of these are sampled out or dropped by the throttle.
+  LogMessage("Log a burst of progress events.");
+  for (int i = 0; i < 1000; ++i) {
+    throttle.LogEvent("progress", "percent", static_cast<double>(i) / 1000.0);
+  }
+  throttle.LogMetrics();
+
   LogMessage("Complete");
 
   // Wait until the user wants to quit the app.
@@ -0,0 +1,384 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "desktop/analytics_benchmark.h"  // NOLINT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+#include <unistd.h>
+#endif  // defined(__linux__)
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "firebase/analytics.h"
+#include "firebase/analytics/event_names.h"
+#include "firebase/analytics/parameter_names.h"
+#include "firebase/analytics/user_property_names.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+#include "analytics_sink.h"  // NOLINT
+#include "event_throttle.h"  // NOLINT
+#include "name_validator.h"  // NOLINT
+#include "user_property_cache.h"  // NOLINT
+
+namespace {
+
+namespace analytics = ::firebase::analytics;
+
+// Where each call made by the benchmark is sent.
+struct Target {
+  EventThrottle* throttle;
+  UserPropertyCache* user_properties;
+};
+
+// The calls made by common_main(), replayed by the benchmark.
+void LogLogin(const Target& target) {
+  if (target.throttle) {
+    target.throttle->LogEvent(analytics::kEventLogin);
+  } else {
+    analytics_sink::LogEvent(analytics::kEventLogin, nullptr, 0);
+  }
+}
+
+void LogProgress(const Target& target) {
+  const analytics::Parameter parameter("percent", 0.4);
+  if (target.throttle) {
+    target.throttle->LogEvent("progress", &parameter, 1);
+  } else {
+    analytics_sink::LogEvent("progress", &parameter, 1);
+  }
+}
+
+void LogPostScore(const Target& target) {
+  const analytics::Parameter parameter(analytics::kParameterScore, 42);
+  if (target.throttle) {
+    target.throttle->LogEvent(analytics::kEventPostScore, &parameter, 1);
+  } else {
+    analytics_sink::LogEvent(analytics::kEventPostScore, &parameter, 1);
+  }
+}
+
+void LogJoinGroup(const Target& target) {
+  const analytics::Parameter parameter(analytics::kParameterGroupID,
+                                       "spoon_welders");
+  if (target.throttle) {
+    target.throttle->LogEvent(analytics::kEventJoinGroup, &parameter, 1);
+  } else {
+    analytics_sink::LogEvent(analytics::kEventJoinGroup, &parameter, 1);
+  }
+}
+
+void LogLevelUp(const Target& target) {
+  const analytics::Parameter kLevelUpParameters[] = {
+      analytics::Parameter(analytics::kParameterLevel, 5),
+      analytics::Parameter(analytics::kParameterCharacter, "mrspoon"),
+      analytics::Parameter("hit_accuracy", 3.14),
+  };
+  const size_t count =
+      sizeof(kLevelUpParameters) / sizeof(kLevelUpParameters[0]);
+  if (target.throttle) {
+    target.throttle->LogEvent(analytics::kEventLevelUp, kLevelUpParameters,
+                              count);
+  } else {
+    analytics_sink::LogEvent(analytics::kEventLevelUp, kLevelUpParameters,
+                             count);
+  }
+}
+
+void SetSignUpMethod(const Target& target) {
+  if (target.user_properties) {
+    target.user_properties->SetUserProperty(
+        analytics::kUserPropertySignUpMethod, "Google");
+  } else {
+    analytics_sink::SetUserProperty(analytics::kUserPropertySignUpMethod,
+                                    "Google");
+  }
+}
+
+struct Call {
+  const char* name;
+  void (*function)(const Target& target);
+};
+
+const Call kCalls[] = {
+    {"login", LogLogin},           {"progress", LogProgress},
+    {"post_score", LogPostScore},  {"join_group", LogJoinGroup},
+    {"level_up", LogLevelUp},      {"user_property", SetSignUpMethod},
+};
+const size_t kNumCalls = sizeof(kCalls) / sizeof(kCalls[0]);
+
+// Returns the value of --name=value from the command line or nullptr.
+const char* GetOption(int argc, const char* argv[], const char* name) {
+  const size_t length = strlen(name);
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], name, length) == 0 && argv[i][length] == '=') {
+      return argv[i] + length + 1;
+    }
+  }
+  return nullptr;
+}
+
+bool HasFlag(int argc, const char* argv[], const char* name) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], name) == 0) return true;
+  }
+  return false;
+}
+
+// Parse a mix of the form "name:weight,name:weight" into a schedule of
+// indices into kCalls, where each call appears weight times.
+bool ParseMix(const char* mix, std::vector<size_t>* schedule) {
+  std::string remaining(mix);
+  while (!remaining.empty()) {
+    size_t end = remaining.find(',');
+    std::string item = remaining.substr(0, end);
+    remaining = end == std::string::npos ? "" : remaining.substr(end + 1);
+    size_t colon = item.find(':');
+    std::string name = item.substr(0, colon);
+    int weight = colon == std::string::npos
+                     ? 1
+                     : atoi(item.substr(colon + 1).c_str());
+    size_t index = 0;
+    while (index < kNumCalls && name != kCalls[index].name) ++index;
+    if (index == kNumCalls || weight < 0) {
+      LogMessage("Benchmark: invalid mix entry '%s'", item.c_str());
+      return false;
+    }
+    schedule->insert(schedule->end(), weight, index);
+  }
+  return !schedule->empty();
+}
+
+// Resident set size of the process in bytes, or 0 if it isn't available.
+size_t ResidentMemoryBytes() {
+#if defined(__linux__)
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (!statm) return 0;
+  unsigned long size_pages = 0, resident_pages = 0;  // NOLINT
+  int read = fscanf(statm, "%lu %lu", &size_pages, &resident_pages);
+  fclose(statm);
+  if (read != 2) return 0;
+  return static_cast<size_t>(resident_pages) *
+         static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return 0;
+#endif  // defined(__linux__)
+}
+
+void RunThread(const Target& target, const std::vector<size_t>& schedule,
+               size_t offset, std::vector<int64_t>* latencies) {
+  const size_t calls = latencies->size();
+  for (size_t i = 0; i < calls; ++i) {
+    const Call& call = kCalls[schedule[(offset + i) % schedule.size()]];
+    int64_t start = LocalAnalyticsSink::NowNanoseconds();
+    call.function(target);
+    (*latencies)[i] = LocalAnalyticsSink::NowNanoseconds() - start;
+  }
+}
+
+// Generate count names similar to those used by apps, roughly 1 in 8 of which
+// break a naming rule.
+std::vector<std::string> GenerateNames(size_t count) {
+  static const char* const kStems[] = {
+      analytics::kEventLogin,     analytics::kEventPostScore,
+      analytics::kEventJoinGroup, analytics::kEventLevelUp,
+      analytics::kParameterScore, analytics::kParameterCharacter,
+      "hit_accuracy",             "progress_percent_complete_for_level",
+  };
+  static const char* const kInvalid[] = {
+      "2fast", "has space", "has-dash", "firebase_reserved",
+      "name_that_is_far_too_long_to_be_accepted_by_analytics",
+  };
+  const size_t num_stems = sizeof(kStems) / sizeof(kStems[0]);
+  const size_t num_invalid = sizeof(kInvalid) / sizeof(kInvalid[0]);
+  std::vector<std::string> names;
+  names.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (i % 8 == 7) {
+      names.push_back(kInvalid[(i / 8) % num_invalid]);
+    } else {
+      names.push_back(kStems[i % num_stems]);
+    }
+  }
+  return names;
+}
+
+// Returns the best time, in nanoseconds, of several runs of validate.
+int64_t TimeValidation(size_t (*validate)(const NameBatch& batch,
+                                          size_t max_length,
+                                          NameStatus* statuses),
+                       const NameBatch& batch, NameStatus* statuses,
+                       size_t* valid) {
+  const int kRuns = 5;
+  int64_t best = 0;
+  for (int run = 0; run < kRuns; ++run) {
+    int64_t start = LocalAnalyticsSink::NowNanoseconds();
+    *valid = validate(batch, kMaxEventNameLength, statuses);
+    int64_t elapsed = LocalAnalyticsSink::NowNanoseconds() - start;
+    if (run == 0 || elapsed < best) best = elapsed;
+  }
+  return best;
+}
+
+// Measure the cost of validating event names in bulk.
+int RunNameValidatorBenchmark(long count) {  // NOLINT
+  std::vector<std::string> names = GenerateNames(static_cast<size_t>(count));
+  NameBatch batch;
+  batch.Reserve(names.size());
+  int64_t start = LocalAnalyticsSink::NowNanoseconds();
+  for (size_t i = 0; i < names.size(); ++i) batch.Add(names[i].c_str());
+  const int64_t pack_ns = LocalAnalyticsSink::NowNanoseconds() - start;
+
+  std::vector<NameStatus> statuses(names.size());
+  size_t valid = 0, scalar_valid = 0;
+  const int64_t vector_ns =
+      TimeValidation(ValidateNames, batch, &statuses[0], &valid);
+  const int64_t scalar_ns =
+      TimeValidation(ValidateNamesScalar, batch, &statuses[0], &scalar_valid);
+  if (valid != scalar_valid) {
+    LogMessage("Benchmark: %s found %d valid names, scalar found %d",
+               NameValidatorImplementation(), static_cast<int>(valid),
+               static_cast<int>(scalar_valid));
+    return 1;
+  }
+
+  // Nanoseconds per name is the same number as milliseconds per million.
+  const double per_million = 1.0 / static_cast<double>(names.size());
+  LogMessage("Benchmark: validated %ld names, %d valid", count,
+             static_cast<int>(valid));
+  LogMessage("Benchmark: packing batch %.2f ms per million names",
+             static_cast<double>(pack_ns) * per_million);
+  LogMessage("Benchmark: %s %.2f ms per million names",
+             NameValidatorImplementation(),
+             static_cast<double>(vector_ns) * per_million);
+  LogMessage("Benchmark: scalar %.2f ms per million names",
+             static_cast<double>(scalar_ns) * per_million);
+  return 0;
+}
+
+}  // namespace
+
+bool AnalyticsBenchmarkRequested(int argc, const char* argv[]) {
+  return HasFlag(argc, argv, "--benchmark");
+}
+
+int RunAnalyticsBenchmark(int argc, const char* argv[]) {
+  const char* option = GetOption(argc, argv, "--events");
+  const long events = option ? atol(option) : 1000000;  // NOLINT
+  option = GetOption(argc, argv, "--threads");
+  const int threads = option ? atoi(option) : 1;
+  option = GetOption(argc, argv, "--mix");
+  std::vector<size_t> schedule;
+  if (option) {
+    if (!ParseMix(option, &schedule)) return 1;
+  } else {
+    for (size_t i = 0; i < kNumCalls; ++i) schedule.push_back(i);
+  }
+  if (events <= 0 || threads <= 0) {
+    LogMessage("Benchmark: --events and --threads must be positive");
+    return 1;
+  }
+  if (HasFlag(argc, argv, "--validator")) {
+    return RunNameValidatorBenchmark(events);
+  }
+  const bool throttled = HasFlag(argc, argv, "--throttle");
+
+  LogMessage("Benchmark: %ld calls on %d thread(s)%s", events, threads,
+             throttled ? " through EventThrottle" : "");
+
+  // Reserve space for every call up front so the sink doesn't reallocate
+  // while the benchmark is running.
+  LocalAnalyticsSink sink(static_cast<size_t>(events));
+  LocalAnalyticsSink::Install(&sink);
+  EventThrottle throttle((EventThrottle::Options()));
+  UserPropertyCache user_properties;
+  Target target;
+  target.throttle = throttled ? &throttle : nullptr;
+  target.user_properties = throttled ? &user_properties : nullptr;
+
+  // Latency samples are written before the benchmark starts, so the only
+  // memory growth other than the sink's records is due to the code under
+  // test.
+  std::vector<std::vector<int64_t>> latencies(threads);
+  for (int i = 0; i < threads; ++i) {
+    latencies[i].resize(static_cast<size_t>(events / threads) +
+                        (i < events % threads ? 1 : 0));
+  }
+  const size_t resident_before = ResidentMemoryBytes();
+  std::vector<std::thread> workers;
+  const int64_t start_ns = LocalAnalyticsSink::NowNanoseconds();
+  for (int i = 0; i < threads; ++i) {
+    workers.push_back(std::thread(RunThread, target, std::cref(schedule),
+                                  static_cast<size_t>(i), &latencies[i]));
+  }
+  for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+  const int64_t end_ns = LocalAnalyticsSink::NowNanoseconds();
+  const size_t resident_after = ResidentMemoryBytes();
+  LocalAnalyticsSink::Install(nullptr);
+
+  std::vector<LocalAnalyticsSink::Record> records = sink.GetRecords();
+  std::vector<int64_t> all_latencies;
+  all_latencies.reserve(static_cast<size_t>(events));
+  for (size_t i = 0; i < latencies.size(); ++i) {
+    all_latencies.insert(all_latencies.end(), latencies[i].begin(),
+                         latencies[i].end());
+  }
+  std::sort(all_latencies.begin(), all_latencies.end());
+
+  const double elapsed_s = static_cast<double>(end_ns - start_ns) * 1e-9;
+  LogMessage("Benchmark: caller calls/sec %.0f",
+             static_cast<double>(events) / elapsed_s);
+  if (records.size() > 1) {
+    const double arrival_s =
+        static_cast<double>(records.back().arrival_ns -
+                            records.front().arrival_ns) *
+        1e-9;
+    LogMessage("Benchmark: sink received %d calls, sustained %.0f events/sec",
+               static_cast<int>(records.size()),
+               static_cast<double>(records.size() - 1) / arrival_s);
+  } else {
+    LogMessage("Benchmark: sink received %d calls",
+               static_cast<int>(records.size()));
+  }
+  const size_t count = all_latencies.size();
+  LogMessage("Benchmark: caller latency ns p50=%lld p90=%lld p99=%lld "
+             "max=%lld",
+             static_cast<long long>(all_latencies[count / 2]),  // NOLINT
+             static_cast<long long>(all_latencies[count * 9 / 10]),  // NOLINT
+             static_cast<long long>(all_latencies[count * 99 / 100]),  // NOLINT
+             static_cast<long long>(all_latencies[count - 1]));  // NOLINT
+  // The sink's records are touched as calls arrive, so exclude them from the
+  // growth attributed to the code under test.
+  const size_t record_bytes = records.size() * sizeof(records[0]);
+  if (resident_before && resident_after) {
+    long long growth = static_cast<long long>(resident_after) -  // NOLINT
+                       static_cast<long long>(resident_before) -  // NOLINT
+                       static_cast<long long>(record_bytes);  // NOLINT
+    LogMessage("Benchmark: resident memory growth %lld KiB excluding %d KiB "
+               "of sink records",
+               growth / 1024, static_cast<int>(record_bytes / 1024));
+  } else {
+    LogMessage("Benchmark: resident memory not available, sink records %d KiB",
+               static_cast<int>(record_bytes / 1024));
+  }
+  if (throttled) throttle.LogMetrics();
+  return 0;
+}
@@ -0,0 +1,40 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DESKTOP_ANALYTICS_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_DESKTOP_ANALYTICS_BENCHMARK_H_  // NOLINT
+
+// Returns true if the command line asks for the benchmark to be run instead
+// of the sample, i.e. contains --benchmark.
+bool AnalyticsBenchmarkRequested(int argc, const char* argv[]);
+
+// Replay a mix of the events logged by the sample into a LocalAnalyticsSink
+// and report sustained events/sec, caller latency and memory growth.
+//
+// Options:
+//   --events=N       Total number of calls to make (default 1000000).
+//   --threads=N      Number of threads making calls (default 1).
+//   --mix=name:weight,...
+//                    Relative frequency of each event, from login, progress,
+//                    post_score, join_group, level_up and user_property
+//                    (default every event with weight 1).
+//   --throttle       Route events through EventThrottle and user properties
+//                    through UserPropertyCache, as the sample does.
+//   --validator      Instead, measure the cost of checking --events names
+//                    with ValidateNames().
+//
+// Returns 0 on success, non-zero if the options are invalid.
+int RunAnalyticsBenchmark(int argc, const char* argv[]);
+
+#endif  // FIREBASE_TESTAPP_DESKTOP_ANALYTICS_BENCHMARK_H_  // NOLINT
@@ -0,0 +1,260 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "event_throttle.h"  // NOLINT
+
+#include <math.h>
+
+#include <chrono>
+#include <vector>
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+#include "analytics_sink.h"  // NOLINT
+
+const char kParameterSamplingWeight[] = "sampling_weight";
+
+namespace {
+
+// Time constant, in seconds, of the generated event rate estimate.
+const double kRateTimeConstant = 1.0;
+
+int64_t NowMicroseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+EventThrottle::EventThrottle(const Options& default_options)
+    : default_options_(default_options),
+      invalid_(0),
+      random_state_(static_cast<uint64_t>(NowMicroseconds()) | 1ULL) {}
+
+void EventThrottle::SetEventOptions(const char* name, const Options& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  event_options_[name] = options;
+  auto it = events_.find(name);
+  if (it != events_.end()) it->second.options = options;
+}
+
+EventThrottle::EventState& EventThrottle::GetState(const char* name) {
+  auto it = events_.find(name);
+  if (it != events_.end()) return it->second;
+  auto options_it = event_options_.find(name);
+  EventState state;
+  state.options = options_it != event_options_.end() ? options_it->second
+                                                     : default_options_;
+  state.tokens = state.options.burst;
+  state.last_refill_us = NowMicroseconds();
+  state.rate = 0.0;
+  state.last_event_us = state.last_refill_us;
+  state.dropped_weight = 0.0;
+  return events_.insert(std::make_pair(std::string(name), state)).first->second;
+}
+
+// xorshift64* generator, returns a value in [0, 1).
+double EventThrottle::NextRandom() {
+  random_state_ ^= random_state_ >> 12;
+  random_state_ ^= random_state_ << 25;
+  random_state_ ^= random_state_ >> 27;
+  uint64_t value = random_state_ * 2685821657736338717ULL;
+  return static_cast<double>(value >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double EventThrottle::Admit(const char* name) {
+  const int64_t now_us = NowMicroseconds();
+  std::lock_guard<std::mutex> lock(mutex_);
+  EventState& state = GetState(name);
+  const Options& options = state.options;
+
+  // Update the estimate of the rate the app is generating this event.
+  double elapsed = static_cast<double>(now_us - state.last_event_us) * 1e-6;
+  state.rate = state.rate * exp(-elapsed / kRateTimeConstant) +
+               1.0 / kRateTimeConstant;
+  state.last_event_us = now_us;
+
+  double weight = 1.0;
+  if (options.target_events_per_second > 0.0 &&
+      state.rate > options.target_events_per_second) {
+    double probability = options.target_events_per_second / state.rate;
+    if (NextRandom() >= probability) {
+      state.metrics.sampled_out++;
+      return 0.0;
+    }
+    weight = 1.0 / probability;
+  }
+
+  elapsed = static_cast<double>(now_us - state.last_refill_us) * 1e-6;
+  state.last_refill_us = now_us;
+  state.tokens += elapsed * options.tokens_per_second;
+  if (state.tokens > options.burst) state.tokens = options.burst;
+  if (state.tokens < 1.0) {
+    // The event stood for weight generated events, which are carried over to
+    // the next logged event rather than lost.
+    state.dropped_weight += weight;
+    state.metrics.dropped++;
+    return 0.0;
+  }
+  state.tokens -= 1.0;
+  state.metrics.logged++;
+  weight += state.dropped_weight;
+  state.dropped_weight = 0.0;
+  return weight;
+}
+
+bool EventThrottle::LogEvent(const char* name) {
+  const ::firebase::analytics::Parameter* no_parameters = nullptr;
+  return LogEvent(name, no_parameters, 0);
+}
+
+bool EventThrottle::LogEvent(const char* name, const char* parameter_name,
+                             const char* parameter_value) {
+  const ::firebase::analytics::Parameter parameter(parameter_name,
+                                                   parameter_value);
+  return LogEvent(name, &parameter, 1);
+}
+
+bool EventThrottle::LogEvent(const char* name, const char* parameter_name,
+                             double parameter_value) {
+  const ::firebase::analytics::Parameter parameter(parameter_name,
+                                                   parameter_value);
+  return LogEvent(name, &parameter, 1);
+}
+
+bool EventThrottle::LogEvent(const char* name, const char* parameter_name,
+                             int64_t parameter_value) {
+  const ::firebase::analytics::Parameter parameter(parameter_name,
+                                                   parameter_value);
+  return LogEvent(name, &parameter, 1);
+}
+
+bool EventThrottle::LogEvent(const char* name, const char* parameter_name,
+                             int parameter_value) {
+  const ::firebase::analytics::Parameter parameter(parameter_name,
+                                                   parameter_value);
+  return LogEvent(name, &parameter, 1);
+}
+
+bool EventThrottle::LogEvent(
+    const char* name, const ::firebase::analytics::Parameter* parameters,
+    size_t number_of_parameters) {
+  namespace analytics = ::firebase::analytics;
+  // Event and parameter names have the same limit, so the names of the whole
+  // event are checked with one ValidateNames() call, and the string values
+  // with one ValidateStringValues() call.
+  static_assert(kMaxEventNameLength == kMaxParameterNameLength,
+                "Event and parameter names are validated together");
+  {
+    std::lock_guard<std::mutex> lock(validate_mutex_);
+    names_.Clear();
+    values_.clear();
+    names_.Add(name);
+    for (size_t i = 0; i < number_of_parameters; ++i) {
+      names_.Add(parameters[i].name);
+      if (parameters[i].value.is_string()) {
+        values_.push_back(parameters[i].value.string_value());
+      }
+    }
+    statuses_.resize(names_.size());
+    if (ValidateNames(names_, kMaxEventNameLength, &statuses_[0]) !=
+        names_.size()) {
+      size_t i = 0;
+      while (statuses_[i] == kNameValid) i++;
+      RecordInvalid(name, i == 0 ? "event name" : parameters[i - 1].name,
+                    NameStatusToString(statuses_[i]));
+      return false;
+    }
+    if (!values_.empty() &&
+        ValidateStringValues(&values_[0], values_.size(),
+                             kMaxParameterStringValueLength,
+                             &statuses_[0]) != values_.size()) {
+      // Find the parameter the first invalid value belongs to.
+      size_t value = 0;
+      while (statuses_[value] == kNameValid) value++;
+      size_t i = 0;
+      for (size_t strings = 0;; ++i) {
+        if (parameters[i].value.is_string() && strings++ == value) break;
+      }
+      RecordInvalid(name, parameters[i].name,
+                    NameStatusToString(statuses_[value]));
+      return false;
+    }
+  }
+
+  double weight = Admit(name);
+  if (weight == 0.0) return false;
+
+  if (weight == 1.0) {
+    analytics_sink::LogEvent(name, parameters, number_of_parameters);
+  } else {
+    std::vector<analytics::Parameter> weighted(
+        parameters, parameters + number_of_parameters);
+    weighted.push_back(analytics::Parameter(kParameterSamplingWeight, weight));
+    analytics_sink::LogEvent(name, &weighted[0], weighted.size());
+  }
+  return true;
+}
+
+void EventThrottle::RecordInvalid(const char* name, const char* what,
+                                  const char* reason) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = events_.find(name);
+  if (it != events_.end()) it->second.metrics.invalid++;
+  // Only report the 1st, 2nd, 4th, 8th... rejection to avoid flooding the
+  // log.
+  if ((invalid_ & (invalid_ + 1)) == 0) {
+    LogMessage("EventThrottle: discarding event %s, %s %s (%llu invalid)",
+               name, what, reason,
+               static_cast<unsigned long long>(invalid_ + 1));  // NOLINT
+  }
+  invalid_++;
+}
+
+EventThrottle::Metrics EventThrottle::GetMetrics(const char* name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = events_.find(name);
+  return it != events_.end() ? it->second.metrics : Metrics();
+}
+
+EventThrottle::Metrics EventThrottle::GetTotalMetrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Metrics total;
+  for (auto it = events_.begin(); it != events_.end(); ++it) {
+    total.logged += it->second.metrics.logged;
+    total.sampled_out += it->second.metrics.sampled_out;
+    total.dropped += it->second.metrics.dropped;
+  }
+  total.invalid = invalid_;
+  return total;
+}
+
+void EventThrottle::LogMetrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = events_.begin(); it != events_.end(); ++it) {
+    const Metrics& metrics = it->second.metrics;
+    LogMessage(
+        "EventThrottle: %s logged=%llu sampled_out=%llu dropped=%llu "
+        "invalid=%llu",
+        it->first.c_str(),
+        static_cast<unsigned long long>(metrics.logged),  // NOLINT
+        static_cast<unsigned long long>(metrics.sampled_out),  // NOLINT
+        static_cast<unsigned long long>(metrics.dropped),  // NOLINT
+        static_cast<unsigned long long>(metrics.invalid));  // NOLINT
+  }
+  LogMessage("EventThrottle: invalid=%llu in total",
+             static_cast<unsigned long long>(invalid_));  // NOLINT
+}
@@ -0,0 +1,152 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_EVENT_THROTTLE_H_  // NOLINT
+#define FIREBASE_TESTAPP_EVENT_THROTTLE_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "firebase/analytics.h"
+
+#include "name_validator.h"  // NOLINT
+
+// Name of the parameter added to sampled events.  Each event that survives
+// sampling records 1 / probability here so that downstream counts can be
+// scaled back up to the number of events the app actually generated.
+extern const char kParameterSamplingWeight[];
+
+// Sits between the app and analytics::LogEvent() to stop a hot loop from
+// flooding the SDK.
+//
+// Each event name gets its own token bucket which caps the sustained rate
+// and burst size.  In front of the bucket an adaptive sampler measures the
+// rate at which the event is generated and, once that exceeds the target
+// rate, only passes a random subset of events through.  Events that are
+// sampled carry kParameterSamplingWeight so nothing is lost statistically.
+// Events that overflow the bucket are dropped and counted, and their weight
+// is added to the next event that's logged so scaled counts stay unbiased
+// when both limits are active.
+//
+// Events with names or string values that Analytics would reject are
+// discarded and counted before they reach the SDK.  The event and parameter
+// names of each event are checked as one batch with ValidateNames().
+//
+// All methods are thread safe.
+class EventThrottle {
+ public:
+  struct Options {
+    Options()
+        : tokens_per_second(10.0), burst(20.0), target_events_per_second(5.0) {}
+
+    // Sustained number of events per second admitted by the token bucket.
+    double tokens_per_second;
+    // Maximum number of events that can be admitted back-to-back.
+    double burst;
+    // Rate above which the sampler starts discarding events.  Set to 0 to
+    // disable sampling for an event.
+    double target_events_per_second;
+  };
+
+  struct Metrics {
+    Metrics() : logged(0), sampled_out(0), dropped(0), invalid(0) {}
+
+    // Events forwarded to the SDK.
+    uint64_t logged;
+    // Events discarded by the sampler; accounted for by sampling weights.
+    uint64_t sampled_out;
+    // Events discarded because the token bucket was empty; accounted for by
+    // the weight of the next logged event.
+    uint64_t dropped;
+    // Events discarded because the event name, a parameter name or a string
+    // parameter value would be rejected by Analytics.
+    uint64_t invalid;
+  };
+
+  // Create a throttle that applies default_options to every event that does
+  // not have options configured by SetEventOptions().
+  explicit EventThrottle(const Options& default_options);
+
+  // Override the options used for the named event.
+  void SetEventOptions(const char* name, const Options& options);
+
+  // Decide whether an event should be logged now.  Returns 0 if the event
+  // must be discarded, otherwise the sampling weight (>= 1) to record.
+  double Admit(const char* name);
+
+  // Throttled equivalents of analytics::LogEvent().  Each returns true if the
+  // event was forwarded to the SDK.
+  bool LogEvent(const char* name);
+  bool LogEvent(const char* name, const char* parameter_name,
+                const char* parameter_value);
+  bool LogEvent(const char* name, const char* parameter_name,
+                double parameter_value);
+  bool LogEvent(const char* name, const char* parameter_name,
+                int64_t parameter_value);
+  bool LogEvent(const char* name, const char* parameter_name,
+                int parameter_value);
+  bool LogEvent(const char* name,
+                const ::firebase::analytics::Parameter* parameters,
+                size_t number_of_parameters);
+
+  // Get the counters for a single event.  Invalid events are only counted
+  // here for names that have been logged before.
+  Metrics GetMetrics(const char* name) const;
+  // Get the counters summed over all events, including every invalid one.
+  Metrics GetTotalMetrics() const;
+  // Write the counters for every event to the log.
+  void LogMetrics() const;
+
+ private:
+  struct EventState {
+    Options options;
+    double tokens;
+    int64_t last_refill_us;
+    // Exponentially weighted moving average of the generated event rate.
+    double rate;
+    int64_t last_event_us;
+    // Weight of events dropped by the bucket since the last logged event.
+    double dropped_weight;
+    Metrics metrics;
+  };
+
+  EventState& GetState(const char* name);
+  // Count an event discarded because of an invalid name or value.  Doesn't
+  // create state for the event, as refused names are often malformed and
+  // unbounded.
+  void RecordInvalid(const char* name, const char* what, const char* reason);
+  double NextRandom();
+
+  // Guards the buffers LogEvent() validates each event with, which are kept
+  // so validating doesn't allocate.
+  std::mutex validate_mutex_;
+  NameBatch names_;
+  std::vector<const char*> values_;
+  std::vector<NameStatus> statuses_;
+
+  mutable std::mutex mutex_;
+  Options default_options_;
+  std::map<std::string, Options> event_options_;
+  std::map<std::string, EventState> events_;
+  // Invalid events over all names, including ones not in events_.
+  uint64_t invalid_;
+  uint64_t random_state_;
+};
+
+#endif  // FIREBASE_TESTAPP_EVENT_THROTTLE_H_  // NOLINT
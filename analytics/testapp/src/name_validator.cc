@@ -0,0 +1,267 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "name_validator.h"  // NOLINT
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NAME_VALIDATOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 is selected at runtime, so it's only built where the compiler can
+// target it for a single function.
+#if NAME_VALIDATOR_SSE2 && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define NAME_VALIDATOR_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct ReservedPrefix {
+  const char* prefix;
+  size_t length;
+};
+
+const ReservedPrefix kReservedPrefixes[] = {
+    {"firebase_", 9}, {"google_", 7}, {"ga_", 3},
+};
+const size_t kNumReservedPrefixes =
+    sizeof(kReservedPrefixes) / sizeof(kReservedPrefixes[0]);
+
+bool IsLetter(uint8_t c) {
+  c |= 0x20;
+  return c >= 'a' && c <= 'z';
+}
+
+bool IsNameCharacter(uint8_t c) {
+  return IsLetter(c) || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Checks everything other than the set of characters used by the name.
+NameStatus CheckStructure(const uint8_t* bytes, size_t length,
+                          size_t max_length) {
+  if (length == 0) return kNameEmpty;
+  if (length > max_length || length > NameBatch::kSlotSize) {
+    return kNameTooLong;
+  }
+  if (!IsLetter(bytes[0])) return kNameBadFirstCharacter;
+  for (size_t i = 0; i < kNumReservedPrefixes; ++i) {
+    const ReservedPrefix& reserved = kReservedPrefixes[i];
+    if (bytes[0] == reserved.prefix[0] &&
+        memcmp(bytes, reserved.prefix, reserved.length) == 0) {
+      return kNameReservedPrefix;
+    }
+  }
+  return kNameValid;
+}
+
+// Each of the following returns true if the first length bytes of a slot
+// only contain name characters.  Bytes after length are zero padding.
+
+bool ScalarCharactersValid(const uint8_t* bytes, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (!IsNameCharacter(bytes[i])) return false;
+  }
+  return true;
+}
+
+#if NAME_VALIDATOR_SSE2
+bool Sse2CharactersValid(const uint8_t* bytes, size_t length) {
+  const __m128i lower_case_bit = _mm_set1_epi8(0x20);
+  const __m128i before_a = _mm_set1_epi8('a' - 1);
+  const __m128i after_z = _mm_set1_epi8('z' + 1);
+  const __m128i before_0 = _mm_set1_epi8('0' - 1);
+  const __m128i after_9 = _mm_set1_epi8('9' + 1);
+  const __m128i underscore = _mm_set1_epi8('_');
+  const __m128i zero = _mm_setzero_si128();
+  for (size_t offset = 0; offset < length; offset += 16) {
+    // Bytes >= 0x80 are negative so fail every range check.
+    __m128i chars =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + offset));
+    __m128i lower = _mm_or_si128(chars, lower_case_bit);
+    __m128i valid = _mm_and_si128(_mm_cmpgt_epi8(lower, before_a),
+                                  _mm_cmplt_epi8(lower, after_z));
+    valid = _mm_or_si128(valid, _mm_and_si128(_mm_cmpgt_epi8(chars, before_0),
+                                              _mm_cmplt_epi8(chars, after_9)));
+    valid = _mm_or_si128(valid, _mm_cmpeq_epi8(chars, underscore));
+    valid = _mm_or_si128(valid, _mm_cmpeq_epi8(chars, zero));
+    if (_mm_movemask_epi8(valid) != 0xFFFF) return false;
+  }
+  return true;
+}
+#endif  // NAME_VALIDATOR_SSE2
+
+#if NAME_VALIDATOR_AVX2
+__attribute__((target("avx2"))) bool Avx2CharactersValid(const uint8_t* bytes,
+                                                         size_t length) {
+  const __m256i lower_case_bit = _mm256_set1_epi8(0x20);
+  const __m256i before_a = _mm256_set1_epi8('a' - 1);
+  const __m256i after_z = _mm256_set1_epi8('z' + 1);
+  const __m256i before_0 = _mm256_set1_epi8('0' - 1);
+  const __m256i after_9 = _mm256_set1_epi8('9' + 1);
+  const __m256i underscore = _mm256_set1_epi8('_');
+  const __m256i zero = _mm256_setzero_si256();
+  for (size_t offset = 0; offset < length; offset += 32) {
+    __m256i chars =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + offset));
+    __m256i lower = _mm256_or_si256(chars, lower_case_bit);
+    __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi8(lower, before_a),
+                                     _mm256_cmpgt_epi8(after_z, lower));
+    valid = _mm256_or_si256(
+        valid, _mm256_and_si256(_mm256_cmpgt_epi8(chars, before_0),
+                                _mm256_cmpgt_epi8(after_9, chars)));
+    valid = _mm256_or_si256(valid, _mm256_cmpeq_epi8(chars, underscore));
+    valid = _mm256_or_si256(valid, _mm256_cmpeq_epi8(chars, zero));
+    if (_mm256_movemask_epi8(valid) != -1) return false;
+  }
+  return true;
+}
+#endif  // NAME_VALIDATOR_AVX2
+
+typedef bool (*CharactersValidFunction)(const uint8_t* bytes, size_t length);
+
+struct Implementation {
+  const char* name;
+  CharactersValidFunction characters_valid;
+};
+
+Implementation SelectImplementation() {
+  Implementation implementation = {"scalar", ScalarCharactersValid};
+#if NAME_VALIDATOR_SSE2
+  implementation.name = "sse2";
+  implementation.characters_valid = Sse2CharactersValid;
+#endif  // NAME_VALIDATOR_SSE2
+#if NAME_VALIDATOR_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    implementation.name = "avx2";
+    implementation.characters_valid = Avx2CharactersValid;
+  }
+#endif  // NAME_VALIDATOR_AVX2
+  return implementation;
+}
+
+const Implementation& GetImplementation() {
+  static const Implementation implementation = SelectImplementation();
+  return implementation;
+}
+
+NameStatus ValidateSlot(const uint8_t* bytes, size_t length,
+                        size_t max_length,
+                        CharactersValidFunction characters_valid) {
+  NameStatus status = CheckStructure(bytes, length, max_length);
+  if (status == kNameValid && !characters_valid(bytes, length)) {
+    status = kNameBadCharacter;
+  }
+  return status;
+}
+
+size_t ValidateBatch(const NameBatch& batch, size_t max_length,
+                     CharactersValidFunction characters_valid,
+                     NameStatus* statuses) {
+  const NameBatch::Slot* slots = batch.slots();
+  const size_t* lengths = batch.lengths();
+  size_t valid = 0;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    statuses[i] =
+        ValidateSlot(slots[i].bytes, lengths[i], max_length, characters_valid);
+    if (statuses[i] == kNameValid) valid++;
+  }
+  return valid;
+}
+
+}  // namespace
+
+const char* NameStatusToString(NameStatus status) {
+  switch (status) {
+    case kNameValid:
+      return "valid";
+    case kNameEmpty:
+      return "empty";
+    case kNameTooLong:
+      return "too long";
+    case kNameBadFirstCharacter:
+      return "doesn't start with a letter";
+    case kNameBadCharacter:
+      return "contains characters other than letters, digits and '_'";
+    case kNameReservedPrefix:
+      return "uses a reserved prefix";
+  }
+  return "unknown";
+}
+
+NameBatch::NameBatch() {}
+
+void NameBatch::Add(const char* name) {
+  const size_t length = strlen(name);
+  Slot slot;
+  memset(slot.bytes, 0, sizeof(slot.bytes));
+  memcpy(slot.bytes, name, length < kSlotSize ? length : kSlotSize);
+  slots_.push_back(slot);
+  lengths_.push_back(length);
+}
+
+void NameBatch::Reserve(size_t count) {
+  slots_.reserve(count);
+  lengths_.reserve(count);
+}
+
+void NameBatch::Clear() {
+  slots_.clear();
+  lengths_.clear();
+}
+
+size_t ValidateNames(const NameBatch& batch, size_t max_length,
+                     NameStatus* statuses) {
+  return ValidateBatch(batch, max_length, GetImplementation().characters_valid,
+                       statuses);
+}
+
+size_t ValidateNamesScalar(const NameBatch& batch, size_t max_length,
+                           NameStatus* statuses) {
+  return ValidateBatch(batch, max_length, ScalarCharactersValid, statuses);
+}
+
+NameStatus ValidateName(const char* name, size_t max_length) {
+  // Only copy as much of the name as is needed to reject it if it's too long.
+  NameBatch::Slot slot;
+  memset(slot.bytes, 0, sizeof(slot.bytes));
+  size_t length = 0;
+  while (name[length] && length < NameBatch::kSlotSize) {
+    slot.bytes[length] = static_cast<uint8_t>(name[length]);
+    length++;
+  }
+  if (name[length]) return kNameTooLong;
+  return ValidateSlot(slot.bytes, length, max_length,
+                      GetImplementation().characters_valid);
+}
+
+size_t ValidateStringValues(const char* const* values, size_t count,
+                            size_t max_length, NameStatus* statuses) {
+  size_t valid = 0;
+  for (size_t i = 0; i < count; ++i) {
+    // Avoid scanning the whole of very long values.
+    const char* value = values[i];
+    size_t length = 0;
+    while (length <= max_length && value[length]) length++;
+    statuses[i] = length > max_length ? kNameTooLong : kNameValid;
+    if (statuses[i] == kNameValid) valid++;
+  }
+  return valid;
+}
+
+const char* NameValidatorImplementation() { return GetImplementation().name; }
@@ -0,0 +1,102 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_NAME_VALIDATOR_H_  // NOLINT
+#define FIREBASE_TESTAPP_NAME_VALIDATOR_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Limits applied by Analytics to the events an app logs.  Events that break
+// them are silently discarded by the SDK at runtime.
+const size_t kMaxEventNameLength = 40;
+const size_t kMaxParameterNameLength = 40;
+const size_t kMaxParameterStringValueLength = 100;
+
+enum NameStatus {
+  kNameValid = 0,
+  kNameEmpty,
+  kNameTooLong,
+  // Names must start with a letter.
+  kNameBadFirstCharacter,
+  // Names may only contain letters, digits and underscores.
+  kNameBadCharacter,
+  // Names starting with "firebase_", "google_" or "ga_" are reserved.
+  kNameReservedPrefix,
+};
+
+// Returns a readable description of status.
+const char* NameStatusToString(NameStatus status);
+
+// A batch of names packed into fixed-size, zero-padded slots so that they can
+// be checked with whole vector loads rather than a byte at a time, without
+// reading past the end of a string.
+class NameBatch {
+ public:
+  // Bytes per slot.  Names longer than this are always too long so only the
+  // first kSlotSize bytes are stored.
+  static const size_t kSlotSize = 64;
+
+  struct Slot {
+    uint8_t bytes[kSlotSize];
+  };
+
+  NameBatch();
+
+  // Append a copy of name to the batch.
+  void Add(const char* name);
+  // Allocate storage for count names.
+  void Reserve(size_t count);
+  // Remove all names, keeping allocated storage.
+  void Clear();
+
+  size_t size() const { return lengths_.size(); }
+  const Slot* slots() const { return slots_.empty() ? nullptr : &slots_[0]; }
+  // Full length of each name, which may exceed kSlotSize.
+  const size_t* lengths() const {
+    return lengths_.empty() ? nullptr : &lengths_[0];
+  }
+
+ private:
+  std::vector<Slot> slots_;
+  std::vector<size_t> lengths_;
+};
+
+// Check every name in batch against the naming rules, writing one status per
+// name to statuses.  Returns the number of valid names.
+//
+// Uses AVX2 or SSE2 when available on the CPU, otherwise scalar code.
+size_t ValidateNames(const NameBatch& batch, size_t max_length,
+                     NameStatus* statuses);
+
+// Same as ValidateNames() but always uses scalar code, for comparison.
+size_t ValidateNamesScalar(const NameBatch& batch, size_t max_length,
+                           NameStatus* statuses);
+
+// Check a single name, e.g. an event or parameter name, against the naming
+// rules.
+NameStatus ValidateName(const char* name, size_t max_length);
+
+// Check the length of string parameter values, writing one status per value
+// to statuses.  Values may contain any characters so only their length is
+// limited.  Returns the number of valid values.
+size_t ValidateStringValues(const char* const* values, size_t count,
+                            size_t max_length, NameStatus* statuses);
+
+// Name of the instruction set used by ValidateNames(), e.g. "avx2".
+const char* NameValidatorImplementation();
+
+#endif  // FIREBASE_TESTAPP_NAME_VALIDATOR_H_  // NOLINT
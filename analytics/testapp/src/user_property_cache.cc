@@ -0,0 +1,87 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "user_property_cache.h"  // NOLINT
+
+#include "analytics_sink.h"  // NOLINT
+
+namespace {
+
+const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+// Hash used for a cleared (null) value.  Distinct from the hash of "".
+const uint64_t kNullValueHash = 0;
+
+// The user ID is cached alongside user properties under a name that can't
+// collide with a property name, as property names can't contain spaces.
+const char kUserIdName[] = " user_id";
+
+// 64-bit FNV-1a hash of a null terminated string.
+uint64_t Hash(const char* str) {
+  uint64_t hash = kFnvOffsetBasis;
+  for (; *str; ++str) {
+    hash ^= static_cast<unsigned char>(*str);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+uint64_t HashValue(const char* value) {
+  if (!value) return kNullValueHash;
+  uint64_t hash = Hash(value);
+  return hash == kNullValueHash ? 1 : hash;
+}
+
+}  // namespace
+
+UserPropertyCache::UserPropertyCache()
+    : forwarded_count_(0), elided_count_(0) {}
+
+bool UserPropertyCache::Update(uint64_t name_hash, uint64_t value_hash) {
+  auto inserted = values_.insert(std::make_pair(name_hash, value_hash));
+  if (!inserted.second) {
+    if (inserted.first->second == value_hash) {
+      elided_count_++;
+      return false;
+    }
+    inserted.first->second = value_hash;
+  }
+  forwarded_count_++;
+  return true;
+}
+
+bool UserPropertyCache::SetUserProperty(const char* name,
+                                        const char* property) {
+  const uint64_t name_hash = Hash(name);
+  const uint64_t value_hash = HashValue(property);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Update(name_hash, value_hash)) return false;
+  analytics_sink::SetUserProperty(name, property);
+  return true;
+}
+
+bool UserPropertyCache::SetUserId(const char* user_id) {
+  static const uint64_t kUserIdNameHash = Hash(kUserIdName);
+  const uint64_t value_hash = HashValue(user_id);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Update(kUserIdNameHash, value_hash)) return false;
+  analytics_sink::SetUserId(user_id);
+  return true;
+}
+
+void UserPropertyCache::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  values_.clear();
+}
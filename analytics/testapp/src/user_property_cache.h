@@ -0,0 +1,67 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_USER_PROPERTY_CACHE_H_  // NOLINT
+#define FIREBASE_TESTAPP_USER_PROPERTY_CACHE_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+// Forwards analytics::SetUserProperty() and analytics::SetUserId() to the SDK
+// only when the value differs from the last one set.
+//
+// Apps tend to set the same user properties on every screen transition.  This
+// cache keeps a 64-bit hash of the current value of each property, so a
+// redundant call costs a hash of the name and value plus a table lookup, and
+// no allocation.
+//
+// All methods are thread safe.  The SDK call is made while holding the cache
+// lock so that the value the SDK sees last is always the value cached.
+class UserPropertyCache {
+ public:
+  UserPropertyCache();
+
+  // Set a user property, see analytics::SetUserProperty().  A null property
+  // clears it.  Returns true if the call was forwarded to the SDK.
+  bool SetUserProperty(const char* name, const char* property);
+
+  // Set the user ID, see analytics::SetUserId().  A null user_id clears it.
+  // Returns true if the call was forwarded to the SDK.
+  bool SetUserId(const char* user_id);
+
+  // Forget all cached values so that the next call for each property is
+  // forwarded, e.g. after analytics is re-initialized.
+  void Reset();
+
+  // Number of calls forwarded to the SDK.
+  uint64_t forwarded_count() const { return forwarded_count_.load(); }
+  // Number of calls that were dropped because the value didn't change.
+  uint64_t elided_count() const { return elided_count_.load(); }
+
+ private:
+  // Returns true if value_hash differs from the cached value for name_hash,
+  // in which case the cache is updated.  Must be called with mutex_ held.
+  bool Update(uint64_t name_hash, uint64_t value_hash);
+
+  std::mutex mutex_;
+  // Hash of the property name to hash of its current value.
+  std::unordered_map<uint64_t, uint64_t> values_;
+  std::atomic<uint64_t> forwarded_count_;
+  std::atomic<uint64_t> elided_count_;
+};
+
+#endif  // FIREBASE_TESTAPP_USER_PROPERTY_CACHE_H_  // NOLINT
@@ -39,6 +39,10 @@ include $(CLEAR_VARS)
 LOCAL_MODULE:=android_main
 LOCAL_SRC_FILES:=\
 	$(LOCAL_PATH)/src/common_main.cc \
+	$(LOCAL_PATH)/src/invites_pipeline.cc \
+	$(LOCAL_PATH)/src/deep_link_router.cc \
+	$(LOCAL_PATH)/src/bulk_invite_sender.cc \
+	$(LOCAL_PATH)/src/invitation_ledger.cc \
 	$(LOCAL_PATH)/src/android/android_main.cc
 LOCAL_STATIC_LIBRARIES:=\
 	firebase_invites \
@@ -56,6 +56,9 @@ jobject GetActivity() { return g_app_state->activity->clazz; }
 // Get the window context. For Android, it's a jobject pointing to the Activity.
 jobject GetWindowContext() { return g_app_state->activity->clazz; }
 
+// Get the app's internal storage directory.
+const char* GetDataPath() { return g_app_state->activity->internalDataPath; }
+
 // Find a class, attempting to load the class if it's not found.
 jclass FindClass(JNIEnv* env, jobject activity_object, const char* class_name) {
   jclass class_object = env->FindClass(class_name);
@@ -0,0 +1,235 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bulk_invite_sender.h"  // NOLINT
+
+#include <algorithm>
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+namespace {
+
+int64_t Milliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+      .count();
+}
+
+}  // namespace
+
+BulkInviteSender::BulkInviteSender(const ::firebase::App& app,
+                                   const Options& options)
+    : options_(options),
+      tokens_(options.burst),
+      refill_time_(std::chrono::steady_clock::now()),
+      pumping_(false),
+      pump_again_(false),
+      running_callbacks_(0),
+      started_(false),
+      total_latency_ms_(0) {
+  for (int i = 0; i < options_.max_in_flight; ++i) {
+    std::unique_ptr<Slot> slot(new Slot());
+    slot->sender.reset(new ::firebase::invites::InvitesSender(app));
+    slot->template_id = -1;
+    slot->busy = false;
+    slot->owner = this;
+    slots_.push_back(std::move(slot));
+  }
+  stats_.queued = 0;
+  stats_.in_flight = 0;
+  stats_.sent = 0;
+  stats_.canceled = 0;
+  stats_.failed = 0;
+  stats_.invitation_ids = 0;
+  stats_.elapsed_ms = 0;
+  stats_.max_latency_ms = 0;
+  stats_.average_latency_ms = 0.0;
+}
+
+int BulkInviteSender::AddTemplate(const InviteTemplate& invite_template) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  templates_.push_back(invite_template);
+  return static_cast<int>(templates_.size() - 1);
+}
+
+bool BulkInviteSender::Send(int template_id, const std::string& group) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (template_id < 0 ||
+      static_cast<size_t>(template_id) >= templates_.size()) {
+    LogMessage("BulkInviteSender: %s has unknown template %d", group.c_str(),
+               template_id);
+    return false;
+  }
+  Job job;
+  job.template_id = template_id;
+  job.group = group;
+  queue_.push_back(job);
+  stats_.queued++;
+  return true;
+}
+
+void BulkInviteSender::Update() { Pump(); }
+
+bool BulkInviteSender::Done() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.empty() && stats_.in_flight == 0 && running_callbacks_ == 0;
+}
+
+bool BulkInviteSender::TakeToken() {
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  const double elapsed_s =
+      std::chrono::duration<double>(now - refill_time_).count();
+  refill_time_ = now;
+  tokens_ = std::min(static_cast<double>(options_.burst),
+                     tokens_ + elapsed_s * options_.invites_per_second);
+  if (tokens_ < 1.0) return false;
+  tokens_ -= 1.0;
+  return true;
+}
+
+void BulkInviteSender::Pump() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A completion callback may run within SendInvite() below, so rather
+    // than starting invitations recursively it asks the running Pump() to
+    // check again.
+    if (pumping_) {
+      pump_again_ = true;
+      return;
+    }
+    pumping_ = true;
+  }
+  for (;;) {
+    Slot* slot = nullptr;
+    InviteTemplate invite_template;
+    int template_id = -1;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!queue_.empty()) {
+        for (size_t i = 0; i < slots_.size() && !slot; ++i) {
+          if (!slots_[i]->busy) slot = slots_[i].get();
+        }
+      }
+      if (!slot || !TakeToken()) {
+        if (pump_again_) {
+          pump_again_ = false;
+          continue;
+        }
+        pumping_ = false;
+        return;
+      }
+      const Job& job = queue_.front();
+      template_id = job.template_id;
+      invite_template = templates_[template_id];
+      slot->busy = true;
+      slot->group = job.group;
+      slot->start_time = std::chrono::steady_clock::now();
+      if (!started_) {
+        started_ = true;
+        first_start_time_ = slot->start_time;
+      }
+      queue_.pop_front();
+      stats_.queued--;
+      stats_.in_flight++;
+    }
+    // Only this thread uses the slot's sender until the invitation
+    // completes.
+    if (slot->template_id != template_id) {
+      slot->sender->SetTitleText(invite_template.title.c_str());
+      slot->sender->SetMessageText(invite_template.message.c_str());
+      slot->sender->SetCallToActionText(
+          invite_template.call_to_action.c_str());
+      slot->sender->SetDeepLinkUrl(invite_template.deep_link_url.c_str());
+      slot->template_id = template_id;
+    }
+    slot->sender->SendInvite().OnCompletion(OnSent, slot);
+  }
+}
+
+void BulkInviteSender::OnSent(
+    const ::firebase::Future< ::firebase::invites::SendInviteResult>&
+        future_result,
+    void* user_data) {
+  Slot* slot = static_cast<Slot*>(user_data);
+  BulkInviteSender* sender = slot->owner;
+  {
+    std::lock_guard<std::mutex> lock(sender->mutex_);
+    const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    const int64_t latency_ms = Milliseconds(now - slot->start_time);
+    Stats& stats = sender->stats_;
+    if (future_result.Status() != ::firebase::kFutureStatusComplete ||
+        future_result.Error() != 0) {
+      LogMessage("BulkInviteSender: %s failed: %d %s", slot->group.c_str(),
+                 future_result.Error(), future_result.ErrorMessage());
+      stats.failed++;
+    } else {
+      const std::vector<std::string>& ids =
+          future_result.Result()->invitation_ids;
+      if (ids.empty()) {
+        stats.canceled++;
+      } else {
+        stats.sent++;
+      }
+      stats.invitation_ids += static_cast<int>(ids.size());
+      sender->invitation_ids_.insert(sender->invitation_ids_.end(),
+                                     ids.begin(), ids.end());
+    }
+    stats.in_flight--;
+    stats.max_latency_ms = std::max(stats.max_latency_ms, latency_ms);
+    sender->total_latency_ms_ += latency_ms;
+    sender->last_complete_time_ = now;
+    slot->busy = false;
+    sender->running_callbacks_++;
+  }
+  // Reuse the slot straight away.
+  sender->Pump();
+  std::lock_guard<std::mutex> lock(sender->mutex_);
+  sender->running_callbacks_--;
+}
+
+BulkInviteSender::Stats BulkInviteSender::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  const int completed = stats.sent + stats.canceled + stats.failed;
+  stats.average_latency_ms =
+      completed ? static_cast<double>(total_latency_ms_) / completed : 0.0;
+  stats.elapsed_ms =
+      started_ && completed
+          ? Milliseconds(last_complete_time_ - first_start_time_)
+          : 0;
+  return stats;
+}
+
+void BulkInviteSender::LogStats() const {
+  const Stats stats = GetStats();
+  const int completed = stats.sent + stats.canceled + stats.failed;
+  LogMessage("BulkInviteSender: sent=%d canceled=%d failed=%d (%.1f%%) "
+             "invitation_ids=%d queued=%d in_flight=%d",
+             stats.sent, stats.canceled, stats.failed,
+             completed ? 100.0 * stats.failed / completed : 0.0,
+             stats.invitation_ids, stats.queued, stats.in_flight);
+  LogMessage("BulkInviteSender: %d invitations in %dms (%.1f/sec), latency "
+             "average %.1fms max %dms",
+             completed, static_cast<int>(stats.elapsed_ms),
+             stats.elapsed_ms ? completed * 1000.0 / stats.elapsed_ms : 0.0,
+             stats.average_latency_ms,
+             static_cast<int>(stats.max_latency_ms));
+}
+
+std::vector<std::string> BulkInviteSender::invitation_ids() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return invitation_ids_;
+}
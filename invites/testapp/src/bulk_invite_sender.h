@@ -0,0 +1,150 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_BULK_INVITE_SENDER_H_  // NOLINT
+#define FIREBASE_TESTAPP_BULK_INVITE_SENDER_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "firebase/app.h"
+#include "firebase/future.h"
+#include "firebase/invites.h"
+
+// Contents of an invitation, applied to an InvitesSender with its setters.
+struct InviteTemplate {
+  std::string title;
+  std::string message;
+  std::string call_to_action;
+  std::string deep_link_url;
+};
+
+// Sends many invitations, e.g. one per recipient group of a campaign, with
+// a bounded number in flight and a limit on the rate they're started.
+//
+// Each invitation in flight uses its own InvitesSender from a pool.  A
+// sender keeps the template it was last configured with, and its setters
+// are only called again when it's used for a different template.
+// Invitations are started from Update() and from the completion callback
+// of the previous invitation, so a slot is reused as soon as it's free,
+// and the results are aggregated as they complete.
+//
+// Methods are thread safe.  The sender must not be destroyed while
+// invitations are in flight.
+class BulkInviteSender {
+ public:
+  struct Options {
+    Options() : max_in_flight(4), invites_per_second(10.0), burst(4) {}
+
+    // Invitations in flight at once, which is the size of the sender pool.
+    int max_in_flight;
+    // Average rate invitations are started at, and the number that can be
+    // started at once after being idle.
+    double invites_per_second;
+    int burst;
+  };
+
+  struct Stats {
+    int queued;
+    int in_flight;
+    // Invitations that completed with at least one invitation ID.
+    int sent;
+    // Invitations that completed without IDs, e.g. the user canceled.
+    int canceled;
+    int failed;
+    // Total invitation IDs returned.
+    int invitation_ids;
+    // Time from the first invitation starting to the last completing.
+    int64_t elapsed_ms;
+    int64_t max_latency_ms;
+    double average_latency_ms;
+  };
+
+  BulkInviteSender(const ::firebase::App& app, const Options& options);
+
+  // Add a template, returning the ID to send it with.
+  int AddTemplate(const InviteTemplate& invite_template);
+  // Queue an invitation using a template, labeled with the recipient group
+  // it's for.  Returns false, without queuing it, if template_id wasn't
+  // returned by AddTemplate().
+  bool Send(int template_id, const std::string& group);
+
+  // Start queued invitations the rate limit allows.  Call periodically, e.g.
+  // from the app's main loop, until Done().
+  void Update();
+  // Whether every queued invitation has completed.
+  bool Done() const;
+
+  Stats GetStats() const;
+  void LogStats() const;
+  // IDs of every invitation sent so far.
+  std::vector<std::string> invitation_ids() const;
+
+ private:
+  struct Job {
+    int template_id;
+    std::string group;
+  };
+
+  // A sender and the invitation it's sending.
+  struct Slot {
+    std::unique_ptr< ::firebase::invites::InvitesSender> sender;
+    // Template the sender is configured with, or -1.
+    int template_id;
+    bool busy;
+    std::string group;
+    std::chrono::steady_clock::time_point start_time;
+    BulkInviteSender* owner;
+  };
+
+  static void OnSent(
+      const ::firebase::Future< ::firebase::invites::SendInviteResult>&
+          result,
+      void* user_data);
+  // Start invitations until none are queued, no slot is free or the rate
+  // limit is reached.
+  void Pump();
+  // Take a token from the rate limiter, if one is available.  Must be called
+  // with mutex_ held.
+  bool TakeToken();
+
+  const Options options_;
+  mutable std::mutex mutex_;
+  std::vector<InviteTemplate> templates_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  std::deque<Job> queue_;
+  // Rate limiter tokens, refilled continuously up to options_.burst.
+  double tokens_;
+  std::chrono::steady_clock::time_point refill_time_;
+  // Whether a thread is in Pump(), and whether it should check again for
+  // invitations to start once it's done.
+  bool pumping_;
+  bool pump_again_;
+  // Completion callbacks still using the sender.
+  int running_callbacks_;
+  bool started_;
+  std::chrono::steady_clock::time_point first_start_time_;
+  std::chrono::steady_clock::time_point last_complete_time_;
+  int64_t total_latency_ms_;
+  Stats stats_;
+  std::vector<std::string> invitation_ids_;
+};
+
+#endif  // FIREBASE_TESTAPP_BULK_INVITE_SENDER_H_  // NOLINT
@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
+#include <string>
+
 #include "firebase/app.h"
 #include "firebase/future.h"
 #include "firebase/invites.h"
@@ -22,8 +25,55 @@
 // Thin OS abstraction layer.
 #include "main.h"  // NOLINT
 
+#include "deep_link_router.h"  // NOLINT
+#include "invitation_ledger.h"  // NOLINT
+#include "invites_pipeline.h"  // NOLINT
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+#include "desktop/invites_benchmark.h"  // NOLINT
+#endif  // !defined(__ANDROID__) && !defined(__APPLE__)
+
+// Register the app's routes for deep links.
+static void AddRoutes(DeepLinkRouter* router) {
+  router->AddRoute("/abc", [](const DeepLinkRouter::Match&) {
+    LogMessage("Route: home");
+  });
+  router->AddRoute("/product/{id:int}",
+                   [](const DeepLinkRouter::Match& match) {
+                     LogMessage("Route: product %lld",  // NOLINT
+                                static_cast<long long>(  // NOLINT
+                                    match.params[0].int_value));
+                   });
+  router->AddRoute("/user/{name}", [](const DeepLinkRouter::Match& match) {
+    LogMessage("Route: user %.*s", static_cast<int>(match.params[0].size),
+               match.params[0].data);
+  });
+  router->Compile();
+}
+
 // Execute all methods of the C++ Invites API.
 extern "C" int common_main(int argc, const char* argv[]) {
+  // Deep link latency is measured from here.
+  const std::chrono::steady_clock::time_point launch_time =
+      std::chrono::steady_clock::now();
+
+  // Routes are compiled before the deep link can arrive.
+  DeepLinkRouter router;
+  AddRoutes(&router);
+  // Invitations converted by earlier runs, which aren't converted again.
+  InvitationLedger ledger;
+  {
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    const bool loaded =
+        ledger.Load(std::string(GetDataPath()) + "/invitation_ledger");
+    LogMessage("%s the invitation ledger, %d converted invitations (%dus)",
+               loaded ? "Loaded" : "Discarded an invalid copy of",
+               static_cast<int>(ledger.size()),
+               static_cast<int>(
+                   std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count()));
+  }
   ::firebase::App* app;
   ::firebase::invites::InvitesSender* sender;
   ::firebase::invites::InvitesReceiver* receiver;
@@ -75,115 +125,48 @@ extern "C" int common_main(int argc, const char* argv[]) {
   }
   LogMessage("Initialized Firebase Invites.");
 
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+  // On desktop the app can run benchmarks rather than the sample.
+  if (InvitesBenchmarkRequested(argc, argv)) {
+    const int result = RunInvitesBenchmark(*app, argc, argv);
+    delete app;
+    return result;
+  }
+#endif  // !defined(__ANDROID__) && !defined(__APPLE__)
+
   LogMessage("Creating an InvitesReceiver");
   receiver = new firebase::invites::InvitesReceiver(*app);
 
   LogMessage("Creating an InvitesSender");
   sender = new firebase::invites::InvitesSender(*app);
 
-  bool testing_conversion = false;
-  {
-    // Check for received invitations.
-    LogMessage("Fetch: Fetching invites...");
-    auto future_result = receiver->Fetch();
-    while (future_result.Status() == firebase::kFutureStatusPending) {
-      if (ProcessEvents(10)) break;
-    }
-
-    if (future_result.Status() == firebase::kFutureStatusInvalid) {
-      LogMessage("Fetch: Invalid, sorry!");
-    } else if (future_result.Status() == firebase::kFutureStatusComplete) {
-      LogMessage("Fetch: Complete!");
-      if (future_result.Error() != 0) {
-        LogMessage("Fetch: Error %d: %s", future_result.Error(),
-                   future_result.ErrorMessage());
-      } else {
-        auto result = *future_result.Result();
-        // error_code == 0
-        if (result.invitation_id != "") {
-          LogMessage("Fetch: Got invitation ID: %s",
-                     result.invitation_id.c_str());
-
-          // We got an invitation ID, so let's try and convert it.
-          LogMessage("ConvertInvitation: Converting invitation %s",
-                     result.invitation_id.c_str());
-
-          receiver->ConvertInvitation(result.invitation_id.c_str());
-          testing_conversion = true;
-        }
-        if (result.deep_link != "") {
-          LogMessage("Fetch: Got deep link: %s", result.deep_link.c_str());
-        }
-        if (result.invitation_id == "" && result.deep_link == "") {
-          LogMessage("Fetch: No invitation ID or deep link, confirmed.");
-        }
-      }
-    }
-  }
-
-  // Check if we are performing a conversion.
-  if (testing_conversion) {
-    auto future_result = receiver->ConvertInvitationLastResult();
-    while (future_result.Status() == firebase::kFutureStatusPending) {
-      if (ProcessEvents(10)) break;
-    }
-
-    if (future_result.Status() == firebase::kFutureStatusInvalid) {
-      LogMessage("ConvertInvitation: Invalid, sorry!");
-    } else if (future_result.Status() == firebase::kFutureStatusComplete) {
-      LogMessage("ConvertInvitation: Complete!");
-      if (future_result.Error() != 0) {
-        LogMessage("ConvertInvitation: Error %d: %s", future_result.Error(),
-                   future_result.ErrorMessage());
-      } else {
-        auto result = *future_result.Result();
-        LogMessage(
-            "ConvertInvitation: Successfully converted invitation ID: %s",
-            result.invitation_id.c_str());
-      }
-    }
-  }
+  // Configure the invitation to send.
+  sender->SetTitleText("Invites Test App");
+  sender->SetMessageText("Please try my app! It's awesome.");
+  sender->SetCallToActionText("Download it for FREE");
+  sender->SetDeepLinkUrl("http://google.com/abc");
 
+  // Fetch and convert received invitations while sending an invitation, each
+  // stage started from the previous stage's completion callback.  The
+  // pipeline is destroyed before the sender and receiver, so if the app
+  // exits while a stage is in progress its callback is ignored.
   {
-    // Now try sending an invitation.
-    LogMessage("SendInvite: Sending an invitation...");
-    sender->SetTitleText("Invites Test App");
-    sender->SetMessageText("Please try my app! It's awesome.");
-    sender->SetCallToActionText("Download it for FREE");
-    sender->SetDeepLinkUrl("http://google.com/abc");
-
-    auto future_result = sender->SendInvite();
-    while (future_result.Status() == firebase::kFutureStatusPending) {
+    InvitesPipeline pipeline(
+        receiver, sender, &ledger, [&router](const std::string& deep_link) {
+          if (!router.Dispatch(deep_link)) {
+            LogMessage("No route for deep link: %s", deep_link.c_str());
+          }
+        });
+    pipeline.Start(launch_time);
+    while (!pipeline.Done()) {
       if (ProcessEvents(10)) break;
     }
+    pipeline.LogMetrics();
+    LogMessage("Sample finished.");
 
-    if (future_result.Status() == firebase::kFutureStatusInvalid) {
-      LogMessage("SendInvite: Invalid, sorry!");
-    } else if (future_result.Status() == firebase::kFutureStatusComplete) {
-      LogMessage("SendInvite: Complete!");
-      if (future_result.Error() != 0) {
-        LogMessage("SendInvite: Error %d: %s", future_result.Error(),
-                   future_result.ErrorMessage());
-      } else {
-        auto result = *future_result.Result();
-        // error == 0
-        if (result.invitation_ids.size() == 0) {
-          LogMessage("SendInvite: Nothing sent, user must have canceled.");
-        } else {
-          LogMessage("SendInvite: %d invites sent successfully.",
-                     result.invitation_ids.size());
-          for (int i = 0; i < result.invitation_ids.size(); i++) {
-            LogMessage("SendInvite: Invite code: %s",
-                       result.invitation_ids[i].c_str());
-          }
-        }
-      }
+    while (!ProcessEvents(1000)) {
     }
   }
-  LogMessage("Sample finished.");
-
-  while (!ProcessEvents(1000)) {
-  }
 
   delete sender;
   sender = nullptr;
@@ -0,0 +1,235 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "deep_link_router.h"  // NOLINT
+
+#include <string.h>
+
+namespace {
+
+// Longest int parameter, so its value fits in an int64_t.
+const size_t kMaxIntDigits = 18;
+
+// Compare a segment of a link with literal text, in the order of
+// std::string::compare().
+int CompareSegment(const char* segment, size_t segment_size,
+                   const char* text, size_t text_size) {
+  const int result = memcmp(segment, text, segment_size < text_size
+                                               ? segment_size
+                                               : text_size);
+  if (result != 0) return result;
+  return segment_size < text_size ? -1 : segment_size > text_size ? 1 : 0;
+}
+
+// Start of the path of link, skipping the scheme and host if present.
+const char* PathStart(const char* link, const char* end) {
+  for (const char* c = link; c + 2 < end; ++c) {
+    if (*c == '/' || *c == '?' || *c == '#') break;
+    if (c[0] == ':' && c[1] == '/' && c[2] == '/') {
+      for (c += 3; c < end && *c != '/' && *c != '?' && *c != '#'; ++c) {
+      }
+      return c;
+    }
+  }
+  return link;
+}
+
+}  // namespace
+
+DeepLinkRouter::DeepLinkRouter() : build_nodes_(1) {}
+
+int DeepLinkRouter::AddRoute(const std::string& pattern,
+                             const Handler& handler) {
+  // Parse the pattern before changing the trie, so an invalid pattern
+  // doesn't leave nodes behind.
+  std::vector<std::string> segments;
+  std::vector<std::string> names;
+  size_t begin = 0;
+  while (begin <= pattern.size()) {
+    size_t end = pattern.find('/', begin);
+    if (end == std::string::npos) end = pattern.size();
+    if (end > begin) segments.push_back(pattern.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const std::string& segment = segments[i];
+    if (segment[0] != '{') {
+      if (segment.find_first_of("{}") != std::string::npos) return -1;
+      continue;
+    }
+    if (segment[segment.size() - 1] != '}' ||
+        static_cast<int>(names.size()) >= kMaxParams) {
+      return -1;
+    }
+    std::string name = segment.substr(1, segment.size() - 2);
+    const size_t colon = name.find(':');
+    if (colon != std::string::npos) {
+      if (name.substr(colon + 1) != "int") return -1;
+      name.resize(colon);
+    }
+    if (name.empty()) return -1;
+    names.push_back(name);
+  }
+
+  int node = 0;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const std::string& segment = segments[i];
+    int child;
+    if (segment[0] != '{') {
+      std::map<std::string, int>::const_iterator it =
+          build_nodes_[node].literals.find(segment);
+      child = it == build_nodes_[node].literals.end() ? -1 : it->second;
+    } else if (segment.find(':') != std::string::npos) {
+      child = build_nodes_[node].int_child;
+    } else {
+      child = build_nodes_[node].string_child;
+    }
+    if (child < 0) {
+      child = static_cast<int>(build_nodes_.size());
+      build_nodes_.push_back(BuildNode());
+      if (segment[0] != '{') {
+        build_nodes_[node].literals[segment] = child;
+      } else if (segment.find(':') != std::string::npos) {
+        build_nodes_[node].int_child = child;
+      } else {
+        build_nodes_[node].string_child = child;
+      }
+    }
+    node = child;
+  }
+  if (build_nodes_[node].route >= 0) return -1;
+  const int route = static_cast<int>(patterns_.size());
+  build_nodes_[node].route = route;
+  patterns_.push_back(pattern);
+  param_names_.push_back(names);
+  handlers_.push_back(handler);
+  return route;
+}
+
+void DeepLinkRouter::Compile() {
+  nodes_.resize(build_nodes_.size());
+  edges_.clear();
+  text_.clear();
+  for (size_t i = 0; i < build_nodes_.size(); ++i) {
+    const BuildNode& build_node = build_nodes_[i];
+    Node& node = nodes_[i];
+    node.first_edge = static_cast<uint32_t>(edges_.size());
+    node.num_edges = static_cast<uint32_t>(build_node.literals.size());
+    node.int_child = build_node.int_child;
+    node.string_child = build_node.string_child;
+    node.route = build_node.route;
+    // std::map is ordered by std::string::compare(), as CompareSegment()
+    // expects.
+    for (std::map<std::string, int>::const_iterator it =
+             build_node.literals.begin();
+         it != build_node.literals.end(); ++it) {
+      Edge edge;
+      edge.offset = static_cast<uint32_t>(text_.size());
+      edge.size = static_cast<uint32_t>(it->first.size());
+      edge.child = static_cast<uint32_t>(it->second);
+      edges_.push_back(edge);
+      text_ += it->first;
+    }
+  }
+}
+
+bool DeepLinkRouter::Find(const char* link, size_t length,
+                          Match* match) const {
+  if (nodes_.empty()) return false;
+  const char* end = link + length;
+  const char* path = PathStart(link, end);
+  const char* path_end = path;
+  while (path_end < end && *path_end != '?' && *path_end != '#') ++path_end;
+  match->query = path_end;
+  match->query_size = 0;
+  if (path_end < end && *path_end == '?') {
+    match->query = path_end + 1;
+    const char* query_end = match->query;
+    while (query_end < end && *query_end != '#') ++query_end;
+    match->query_size = static_cast<size_t>(query_end - match->query);
+  }
+  return FindFrom(0, path, path_end, 0, match);
+}
+
+bool DeepLinkRouter::FindFrom(int node_index, const char* begin,
+                              const char* end, int depth,
+                              Match* match) const {
+  while (begin < end && *begin == '/') ++begin;
+  const Node& node = nodes_[node_index];
+  if (begin == end) {
+    if (node.route < 0) return false;
+    match->route = node.route;
+    match->num_params = depth;
+    return true;
+  }
+  const char* segment_end = begin;
+  while (segment_end < end && *segment_end != '/') ++segment_end;
+  const size_t size = static_cast<size_t>(segment_end - begin);
+
+  // Literal children, by binary search.
+  uint32_t low = node.first_edge;
+  uint32_t high = node.first_edge + node.num_edges;
+  while (low < high) {
+    const uint32_t middle = low + (high - low) / 2;
+    const Edge& edge = edges_[middle];
+    const int order =
+        CompareSegment(begin, size, text_.data() + edge.offset, edge.size);
+    if (order == 0) {
+      if (FindFrom(static_cast<int>(edge.child), segment_end, end, depth,
+                   match)) {
+        return true;
+      }
+      break;
+    }
+    if (order < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  if (depth >= kMaxParams) return false;
+  Param& param = match->params[depth];
+  param.data = begin;
+  param.size = size;
+  if (node.int_child >= 0 && size <= kMaxIntDigits) {
+    int64_t value = 0;
+    const char* c = begin;
+    for (; c < segment_end && *c >= '0' && *c <= '9'; ++c) {
+      value = value * 10 + (*c - '0');
+    }
+    if (c == segment_end) {
+      param.type = kParamInt;
+      param.int_value = value;
+      if (FindFrom(node.int_child, segment_end, end, depth + 1, match)) {
+        return true;
+      }
+    }
+  }
+  if (node.string_child >= 0) {
+    param.type = kParamString;
+    param.int_value = 0;
+    if (FindFrom(node.string_child, segment_end, end, depth + 1, match)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DeepLinkRouter::Dispatch(const char* link, size_t length) const {
+  Match match;
+  if (!Find(link, length, &match)) return false;
+  const Handler& handler = handlers_[match.route];
+  if (handler) handler(match);
+  return true;
+}
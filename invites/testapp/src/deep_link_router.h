@@ -0,0 +1,148 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DEEP_LINK_ROUTER_H_  // NOLINT
+#define FIREBASE_TESTAPP_DEEP_LINK_ROUTER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Maps the path of a deep link onto one of the app's routes.
+//
+// Routes are patterns of path segments, each either literal text, "{name}"
+// which captures any segment, or "{name:int}" which captures a segment of
+// decimal digits, e.g. "/product/{id:int}/reviews".  Compile() builds a trie
+// of the segments in flat arrays.  Find() then walks a link's path once,
+// matching each segment against the literal children of a trie node with a
+// binary search, and captures parameters as pointers into the link, so
+// routing a link doesn't allocate.
+//
+// When more than one route matches, literal segments take priority over
+// int parameters, which take priority over string parameters.
+//
+// The scheme, host, query and fragment of a link are ignored when routing.
+// Empty segments are skipped, so "/a//b/" matches "/a/b".
+//
+// Routes are added and compiled on one thread.  Once compiled, Find() and
+// Dispatch() can be called from any thread.
+class DeepLinkRouter {
+ public:
+  // Maximum number of parameters in a route.
+  static const int kMaxParams = 8;
+
+  enum ParamType {
+    kParamString,
+    kParamInt,
+  };
+
+  // A parameter captured from a link, pointing into the link.
+  struct Param {
+    ParamType type;
+    const char* data;
+    size_t size;
+    // Value of a kParamInt parameter.
+    int64_t int_value;
+  };
+
+  struct Match {
+    // Index of the matching route.
+    int route;
+    int num_params;
+    // Parameters in the order they appear in the route.
+    Param params[kMaxParams];
+    // The link's query string, without the '?', or empty.
+    const char* query;
+    size_t query_size;
+  };
+
+  // Called with a link's match by Dispatch().
+  typedef std::function<void(const Match& match)> Handler;
+
+  DeepLinkRouter();
+
+  // Add a route, returning its index, or -1 if pattern is invalid or a
+  // route with the same segments was already added.
+  int AddRoute(const std::string& pattern, const Handler& handler);
+
+  // Build the lookup tables.  Must be called after adding routes, before
+  // routing links.
+  void Compile();
+
+  // Find the route matching the path of the link, of length bytes.  Returns
+  // false if no route matches.
+  bool Find(const char* link, size_t length, Match* match) const;
+
+  // Find the route matching the link and call its handler.  Returns false if
+  // no route matches.
+  bool Dispatch(const char* link, size_t length) const;
+  bool Dispatch(const std::string& link) const {
+    return Dispatch(link.data(), link.size());
+  }
+
+  // Number of routes.
+  size_t size() const { return patterns_.size(); }
+  const std::string& pattern(int route) const { return patterns_[route]; }
+  // Name of parameter i of route.
+  const std::string& param_name(int route, int i) const {
+    return param_names_[route][i];
+  }
+
+ private:
+  // Trie node while routes are added.
+  struct BuildNode {
+    BuildNode() : int_child(-1), string_child(-1), route(-1) {}
+
+    std::map<std::string, int> literals;
+    int int_child;
+    int string_child;
+    int route;
+  };
+
+  // Compiled trie node.  Its literal children are the edges first_edge to
+  // first_edge + num_edges - 1, sorted by text.
+  struct Node {
+    uint32_t first_edge;
+    uint32_t num_edges;
+    int32_t int_child;
+    int32_t string_child;
+    int32_t route;
+  };
+
+  // Literal segment, as text_[offset, offset + size), leading to child.
+  struct Edge {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t child;
+  };
+
+  // Match the path from begin to end against the subtree at node, with
+  // depth parameters captured so far.
+  bool FindFrom(int node, const char* begin, const char* end, int depth,
+                Match* match) const;
+
+  std::vector<BuildNode> build_nodes_;
+  std::vector<Node> nodes_;
+  std::vector<Edge> edges_;
+  std::string text_;
+  std::vector<std::string> patterns_;
+  std::vector<std::vector<std::string>> param_names_;
+  std::vector<Handler> handlers_;
+};
+
+#endif  // FIREBASE_TESTAPP_DEEP_LINK_ROUTER_H_  // NOLINT
@@ -0,0 +1,27 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DESKTOP_ALLOCATION_COUNTER_H_  // NOLINT
+#define FIREBASE_TESTAPP_DESKTOP_ALLOCATION_COUNTER_H_  // NOLINT
+
+#include <stdint.h>
+
+// Number of calls to operator new made by the process so far.
+//
+// Desktop builds replace the global operator new and delete with versions
+// that count allocations, so benchmarks can report allocations per
+// operation.
+uint64_t AllocationCount();
+
+#endif  // FIREBASE_TESTAPP_DESKTOP_ALLOCATION_COUNTER_H_  // NOLINT
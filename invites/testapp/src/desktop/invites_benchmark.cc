@@ -0,0 +1,287 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "desktop/invites_benchmark.h"  // NOLINT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "firebase/app.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+#include "bulk_invite_sender.h"  // NOLINT
+#include "deep_link_router.h"  // NOLINT
+#include "desktop/allocation_counter.h"  // NOLINT
+
+namespace {
+
+// Returns the value of --name=value from the command line or nullptr.
+const char* GetOption(int argc, const char* argv[], const char* name) {
+  const size_t length = strlen(name);
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], name, length) == 0 && argv[i][length] == '=') {
+      return argv[i] + length + 1;
+    }
+  }
+  return nullptr;
+}
+
+bool HasFlag(int argc, const char* argv[], const char* name) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], name) == 0) return true;
+  }
+  return false;
+}
+
+int GetIntOption(int argc, const char* argv[], const char* name,
+                 int default_value) {
+  const char* value = GetOption(argc, argv, name);
+  return value ? atoi(value) : default_value;
+}
+
+int64_t NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::vector<std::string> SplitPath(const std::string& path) {
+  std::vector<std::string> segments;
+  size_t begin = 0;
+  while (begin <= path.size()) {
+    size_t end = path.find('/', begin);
+    if (end == std::string::npos) end = path.size();
+    if (end > begin) segments.push_back(path.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return segments;
+}
+
+// Routes a link by splitting its path and comparing it with each route's
+// segments in turn, as an app without a router would.
+class LinearRouter {
+ public:
+  void AddRoute(const std::string& pattern) {
+    routes_.push_back(SplitPath(pattern));
+  }
+
+  int Find(const std::string& link) const {
+    std::string path = link;
+    const size_t scheme = path.find("://");
+    if (scheme != std::string::npos) {
+      const size_t slash = path.find('/', scheme + 3);
+      path = slash == std::string::npos ? "" : path.substr(slash);
+    }
+    path = path.substr(0, path.find_first_of("?#"));
+    const std::vector<std::string> segments = SplitPath(path);
+    for (size_t r = 0; r < routes_.size(); ++r) {
+      const std::vector<std::string>& route = routes_[r];
+      if (route.size() != segments.size()) continue;
+      bool matches = true;
+      for (size_t s = 0; s < route.size() && matches; ++s) {
+        const std::string& segment = route[s];
+        if (segment.size() > 5 &&
+            segment.compare(segment.size() - 5, 5, ":int}") == 0) {
+          matches = segments[s].find_first_not_of("0123456789") ==
+                    std::string::npos;
+        } else if (segment[0] != '{') {
+          matches = segment == segments[s];
+        }
+      }
+      if (matches) return static_cast<int>(r);
+    }
+    return -1;
+  }
+
+ private:
+  std::vector<std::vector<std::string>> routes_;
+};
+
+// Compare routing links with a DeepLinkRouter against a LinearRouter, over
+// routes in several sections of an app, and links of which 1 in 10 don't
+// match any route.
+int RunRouterBenchmark(int num_routes, int num_links) {
+  DeepLinkRouter router;
+  LinearRouter linear_router;
+  uint64_t handled = 0;
+  for (int i = 0; i < num_routes; ++i) {
+    const std::string section = "/section" + std::to_string(i / 4);
+    std::string pattern;
+    switch (i % 4) {
+      case 0:
+        pattern = section + "/items/{id:int}";
+        break;
+      case 1:
+        pattern = section + "/users/{name}/posts/{post:int}";
+        break;
+      case 2:
+        pattern = section + "/about";
+        break;
+      default:
+        pattern = section + "/search/{query}";
+        break;
+    }
+    router.AddRoute(pattern, [&handled](const DeepLinkRouter::Match& match) {
+      handled += static_cast<uint64_t>(match.num_params);
+    });
+    linear_router.AddRoute(pattern);
+  }
+  router.Compile();
+
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int> route(0, num_routes - 1);
+  std::vector<std::string> links;
+  std::vector<int> expected;
+  for (int i = 0; i < num_links; ++i) {
+    const int r = route(random);
+    const std::string section = "/section" + std::to_string(r / 4);
+    std::string path;
+    switch (r % 4) {
+      case 0:
+        path = section + "/items/" + std::to_string(r * 7);
+        break;
+      case 1:
+        path = section + "/users/ann/posts/" + std::to_string(r);
+        break;
+      case 2:
+        path = section + "/about";
+        break;
+      default:
+        path = section + "/search/shoes";
+        break;
+    }
+    const bool miss = i % 10 == 9;
+    if (miss) path += "/missing";
+    links.push_back("https://example.com" + path + "?utm_source=invite");
+    expected.push_back(miss ? -1 : r);
+  }
+
+  // Check both routers agree with the expected routes before timing them.
+  for (size_t i = 0; i < links.size(); ++i) {
+    DeepLinkRouter::Match match;
+    const int found =
+        router.Find(links[i].data(), links[i].size(), &match) ? match.route
+                                                               : -1;
+    if (found != expected[i] || linear_router.Find(links[i]) != expected[i]) {
+      LogMessage("Benchmark: %s matched route %d, expected %d",
+                 links[i].c_str(), found, expected[i]);
+      return 1;
+    }
+  }
+
+  int64_t start = NowNanoseconds();
+  uint64_t allocations = AllocationCount();
+  int matched = 0;
+  for (size_t i = 0; i < links.size(); ++i) {
+    if (router.Dispatch(links[i])) matched++;
+  }
+  const int64_t router_ns = NowNanoseconds() - start;
+  const uint64_t router_allocations = AllocationCount() - allocations;
+
+  start = NowNanoseconds();
+  allocations = AllocationCount();
+  int linear_matched = 0;
+  for (size_t i = 0; i < links.size(); ++i) {
+    if (linear_router.Find(links[i]) >= 0) linear_matched++;
+  }
+  const int64_t linear_ns = NowNanoseconds() - start;
+  const uint64_t linear_allocations = AllocationCount() - allocations;
+
+  LogMessage("Benchmark: %d links over %d routes, %d matched (%d params)",
+             num_links, num_routes, matched, static_cast<int>(handled));
+  if (matched != linear_matched) return 1;
+  LogMessage("Benchmark: DeepLinkRouter %12.0f routes/sec %8.1f ns/link "
+             "%.2f allocations/link",
+             num_links * 1e9 / router_ns,
+             static_cast<double>(router_ns) / num_links,
+             static_cast<double>(router_allocations) / num_links);
+  LogMessage("Benchmark: linear        %12.0f routes/sec %8.1f ns/link "
+             "%.2f allocations/link",
+             num_links * 1e9 / linear_ns,
+             static_cast<double>(linear_ns) / num_links,
+             static_cast<double>(linear_allocations) / num_links);
+  return 0;
+}
+
+// Send invitations to groups with a BulkInviteSender, cycling through a few
+// templates, and report its throughput and failures.
+int RunBulkSendBenchmark(const ::firebase::App& app, int invites,
+                         const BulkInviteSender::Options& options) {
+  BulkInviteSender sender(app, options);
+  const int kTemplates = 3;
+  for (int t = 0; t < kTemplates; ++t) {
+    InviteTemplate invite_template;
+    invite_template.title = "Invites Test App";
+    invite_template.message = "Campaign message " + std::to_string(t);
+    invite_template.call_to_action = "Download it for FREE";
+    invite_template.deep_link_url =
+        "http://google.com/campaign/" + std::to_string(t);
+    sender.AddTemplate(invite_template);
+  }
+  for (int i = 0; i < invites; ++i) {
+    sender.Send(i % kTemplates, "group" + std::to_string(i));
+  }
+  LogMessage("Benchmark: %d invitations, %d in flight, %.0f/sec, burst %d",
+             invites, options.max_in_flight, options.invites_per_second,
+             options.burst);
+  while (!sender.Done()) {
+    sender.Update();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  sender.LogStats();
+  return 0;
+}
+
+}  // namespace
+
+bool InvitesBenchmarkRequested(int argc, const char* argv[]) {
+  return HasFlag(argc, argv, "--benchmark");
+}
+
+int RunInvitesBenchmark(const ::firebase::App& app, int argc,
+                        const char* argv[]) {
+  if (HasFlag(argc, argv, "--router")) {
+    const int routes = GetIntOption(argc, argv, "--routes", 2000);
+    const int links = GetIntOption(argc, argv, "--links", 200000);
+    if (routes <= 0 || links <= 0) {
+      LogMessage("Benchmark: --routes and --links must be positive");
+      return 1;
+    }
+    return RunRouterBenchmark(routes, links);
+  }
+  if (HasFlag(argc, argv, "--bulk")) {
+    const int invites = GetIntOption(argc, argv, "--invites", 100);
+    BulkInviteSender::Options options;
+    options.max_in_flight = GetIntOption(argc, argv, "--in_flight", 4);
+    options.invites_per_second = GetIntOption(argc, argv, "--rate", 50);
+    options.burst = GetIntOption(argc, argv, "--burst", 4);
+    if (invites <= 0 || options.max_in_flight <= 0 ||
+        options.invites_per_second <= 0 || options.burst <= 0) {
+      LogMessage("Benchmark: --invites, --in_flight, --rate and --burst must "
+                 "be positive");
+      return 1;
+    }
+    return RunBulkSendBenchmark(app, invites, options);
+  }
+  LogMessage("Benchmark: specify a benchmark, e.g. --router or --bulk");
+  return 1;
+}
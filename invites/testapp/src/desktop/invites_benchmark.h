@@ -0,0 +1,44 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DESKTOP_INVITES_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_DESKTOP_INVITES_BENCHMARK_H_  // NOLINT
+
+#include "firebase/app.h"
+
+// Returns true if the command line asks for a benchmark to be run instead of
+// the sample, i.e. contains --benchmark.
+bool InvitesBenchmarkRequested(int argc, const char* argv[]);
+
+// Run the benchmark selected on the command line.  Invites must be
+// initialized.
+//
+// Options:
+//   --router         Compare routing links with a compiled DeepLinkRouter
+//                    against matching each route's pattern in turn.
+//   --routes=N       Number of routes (default 2000).
+//   --links=N        Number of links routed (default 200000).
+//   --bulk           Send invitations with a BulkInviteSender and report
+//                    its throughput and failures.
+//   --invites=N      Number of invitations sent (default 100).
+//   --in_flight=N    Invitations in flight at once (default 4).
+//   --rate=N         Invitations started per second (default 50).
+//   --burst=N        Invitations started at once after being idle
+//                    (default 4).
+//
+// Returns 0 on success, non-zero if the options are invalid.
+int RunInvitesBenchmark(const ::firebase::App& app, int argc,
+                        const char* argv[]);
+
+#endif  // FIREBASE_TESTAPP_DESKTOP_INVITES_BENCHMARK_H_  // NOLINT
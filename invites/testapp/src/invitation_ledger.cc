@@ -0,0 +1,251 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "invitation_ledger.h"  // NOLINT
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // defined(_WIN32)
+
+namespace {
+
+const char kMagic[8] = {'i', 'n', 'v', 'l', 'e', 'd', 'g', 'r'};
+// Changed if the file layout changes.
+const uint32_t kVersion = 1;
+
+// Start of a ledger file, followed by count offsets, relative to the end of
+// the header, of the sorted IDs.
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t count;
+  // Bytes after the header.
+  uint32_t size;
+  // Checksum() of the bytes after the header.
+  uint32_t checksum;
+};
+
+// FNV-1a hash of size bytes of data.
+uint32_t Checksum(const char* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+// Check the IDs are in bounds, null terminated, sorted and unique.
+bool Validate(const char* data, size_t size, uint32_t count) {
+  if (count > size / sizeof(uint32_t)) return false;
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(data);
+  const size_t table_size = count * sizeof(uint32_t);
+  const char* previous = nullptr;
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t offset = offsets[i];
+    if (offset < table_size || offset >= size ||
+        !memchr(data + offset, 0, size - offset)) {
+      return false;
+    }
+    const char* id = data + offset;
+    if (previous && strcmp(previous, id) >= 0) return false;
+    previous = id;
+  }
+  return true;
+}
+
+}  // namespace
+
+InvitationLedger::InvitationLedger()
+    : data_(nullptr), offsets_(nullptr), count_(0) {}
+
+bool InvitationLedger::Load(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  path_ = path;
+  added_.clear();
+  return LoadLocked();
+}
+
+#if !defined(_WIN32)
+
+bool InvitationLedger::LoadLocked() {
+  storage_.reset();
+  data_ = nullptr;
+  offsets_ = nullptr;
+  count_ = 0;
+  int fd = open(path_.c_str(), O_RDONLY);
+  if (fd < 0) return true;
+  struct stat status;
+  void* mapping = MAP_FAILED;
+  size_t file_size = 0;
+  if (fstat(fd, &status) == 0 &&
+      static_cast<size_t>(status.st_size) >= sizeof(FileHeader)) {
+    file_size = static_cast<size_t>(status.st_size);
+    mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+  std::shared_ptr<const void> storage(
+      mapping, [file_size](const void* data) {
+        munmap(const_cast<void*>(data), file_size);
+      });
+  const char* file = static_cast<const char*>(mapping);
+
+#else
+
+// Windows doesn't have mmap(), so the file is read into memory.
+bool InvitationLedger::LoadLocked() {
+  storage_.reset();
+  data_ = nullptr;
+  offsets_ = nullptr;
+  count_ = 0;
+  FILE* input = fopen(path_.c_str(), "rb");
+  if (!input) return true;
+  std::string contents;
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), input)) > 0) {
+    contents.append(buffer, read);
+  }
+  fclose(input);
+  const size_t file_size = contents.size();
+  std::shared_ptr<char> copy(new char[file_size + 1],
+                             std::default_delete<char[]>());
+  memcpy(copy.get(), contents.data(), file_size);
+  const char* file = copy.get();
+  std::shared_ptr<const void> storage(std::move(copy));
+
+#endif  // !defined(_WIN32)
+
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(file);
+  const char* data = file + sizeof(FileHeader);
+  if (file_size < sizeof(FileHeader) ||
+      memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion ||
+      header->size != file_size - sizeof(FileHeader) ||
+      header->checksum != Checksum(data, header->size) ||
+      !Validate(data, header->size, header->count)) {
+    return false;
+  }
+  storage_ = std::move(storage);
+  data_ = data;
+  offsets_ = reinterpret_cast<const uint32_t*>(data);
+  count_ = header->count;
+  return true;
+}
+
+const char* InvitationLedger::MappedId(uint32_t index) const {
+  return data_ + offsets_[index];
+}
+
+bool InvitationLedger::ContainsMapped(const char* id) const {
+  uint32_t low = 0;
+  uint32_t high = count_;
+  while (low < high) {
+    const uint32_t middle = low + (high - low) / 2;
+    const int order = strcmp(id, MappedId(middle));
+    if (order == 0) return true;
+    if (order < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  return false;
+}
+
+bool InvitationLedger::Contains(const std::string& id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return added_.count(id) != 0 || ContainsMapped(id.c_str());
+}
+
+void InvitationLedger::Add(const std::string& id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!ContainsMapped(id.c_str())) added_.insert(id);
+}
+
+size_t InvitationLedger::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return count_ + added_.size();
+}
+
+bool InvitationLedger::Save() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (path_.empty()) return false;
+  std::vector<std::string> ids(added_.begin(), added_.end());
+  for (uint32_t i = 0; i < count_; ++i) ids.push_back(MappedId(i));
+  std::sort(ids.begin(), ids.end());
+
+  // IDs can't contain a null character, as they're stored null terminated.
+  std::string data(ids.size() * sizeof(uint32_t), '\0');
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const uint32_t offset = static_cast<uint32_t>(data.size());
+    memcpy(&data[i * sizeof(uint32_t)], &offset, sizeof(offset));
+    data.append(ids[i].c_str(), strlen(ids[i].c_str()) + 1);
+  }
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.count = static_cast<uint32_t>(ids.size());
+  header.size = static_cast<uint32_t>(data.size());
+  header.checksum = Checksum(data.data(), data.size());
+
+  // Write a new file and rename it over the old one, so the ledger is never
+  // partially written, and the current mapping is unaffected.  If anything
+  // fails the ledger in memory and on disk is unchanged.
+  const std::string temp_path = path_ + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (!file) return false;
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(data.data(), 1, data.size(), file) == data.size() &&
+                 fflush(file) == 0;
+#if !defined(_WIN32)
+  // Make sure the contents reach the disk before the rename, or a crash could
+  // leave an empty ledger in place of the old one.
+  written = written && fsync(fileno(file)) == 0;
+#endif  // !defined(_WIN32)
+  written = fclose(file) == 0 && written;
+#if defined(_WIN32)
+  // rename() can't replace an existing file on Windows.
+  const bool renamed =
+      written && MoveFileExA(temp_path.c_str(), path_.c_str(),
+                             MOVEFILE_REPLACE_EXISTING |
+                                 MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  const bool renamed =
+      written && rename(temp_path.c_str(), path_.c_str()) == 0;
+#endif  // defined(_WIN32)
+  if (!renamed) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  // Map the new file in place of the IDs added since the last load.  If it
+  // can't be read back every ID is kept in memory instead.
+  added_.clear();
+  if (!LoadLocked()) {
+    added_.insert(ids.begin(), ids.end());
+    return false;
+  }
+  return true;
+}
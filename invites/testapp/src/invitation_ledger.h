@@ -0,0 +1,73 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_INVITATION_LEDGER_H_  // NOLINT
+#define FIREBASE_TESTAPP_INVITATION_LEDGER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+// Invitation IDs that have already been converted, kept between runs of the
+// app so ConvertInvitation() isn't called again for the same invitation.
+//
+// The ledger file holds the IDs sorted, as a table of offsets followed by
+// the null terminated IDs, after a header with a version and checksum.
+// Load() maps the file and looks IDs up with a binary search of the
+// mapping, so loading doesn't parse or copy the IDs.  IDs added since the
+// file was loaded are kept in a hash set until Save() writes them, merged
+// with the mapped IDs, to a new file.
+//
+// All methods are thread safe.
+class InvitationLedger {
+ public:
+  InvitationLedger();
+
+  // Map the ledger at path, which Save() writes to.  A missing file is an
+  // empty ledger.  Returns false if the file is invalid, in which case the
+  // ledger is empty.
+  bool Load(const std::string& path);
+
+  // Whether id has been added.
+  bool Contains(const std::string& id) const;
+  // Add a converted invitation's ID.
+  void Add(const std::string& id);
+  // Write every ID to the file, replacing it atomically, and map it.
+  bool Save();
+
+  // Number of IDs.
+  size_t size() const;
+
+ private:
+  // Maps the file at path_.  Must be called with mutex_ held.
+  bool LoadLocked();
+  // Whether id is in the mapped file.  Must be called with mutex_ held.
+  bool ContainsMapped(const char* id) const;
+  const char* MappedId(uint32_t index) const;
+
+  mutable std::mutex mutex_;
+  std::string path_;
+  // Keeps the mapping, or on Windows the file's contents, alive.
+  std::shared_ptr<const void> storage_;
+  const char* data_;
+  const uint32_t* offsets_;
+  uint32_t count_;
+  std::unordered_set<std::string> added_;
+};
+
+#endif  // FIREBASE_TESTAPP_INVITATION_LEDGER_H_  // NOLINT
@@ -0,0 +1,216 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "invites_pipeline.h"  // NOLINT
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+InvitesPipeline::InvitesPipeline(
+    ::firebase::invites::InvitesReceiver* receiver,
+    ::firebase::invites::InvitesSender* sender,
+    InvitationLedger* ledger,
+    const DeepLinkHandler& deep_link_handler)
+    : receiver_(receiver),
+      sender_(sender),
+      ledger_(ledger),
+      deep_link_handler_(deep_link_handler),
+      context_(new Context()),
+      pending_(0) {
+  context_->pipeline = this;
+  context_->references = 1;
+  metrics_.fetch_ms = -1;
+  metrics_.deep_link_ms = -1;
+  metrics_.convert_ms = -1;
+  metrics_.send_ms = -1;
+}
+
+InvitesPipeline::~InvitesPipeline() {
+  {
+    std::lock_guard<std::recursive_mutex> lock(context_->mutex);
+    context_->pipeline = nullptr;
+  }
+  Release(context_);
+}
+
+InvitesPipeline::Context* InvitesPipeline::StartStage() {
+  std::lock_guard<std::recursive_mutex> lock(context_->mutex);
+  context_->references++;
+  pending_++;
+  return context_;
+}
+
+void InvitesPipeline::Release(Context* context) {
+  bool last;
+  {
+    std::lock_guard<std::recursive_mutex> lock(context->mutex);
+    last = --context->references == 0;
+  }
+  if (last) delete context;
+}
+
+template <typename T, void (InvitesPipeline::*handler)(
+                          const ::firebase::Future<T>&)>
+void InvitesPipeline::Dispatch(const ::firebase::Future<T>& result,
+                               void* user_data) {
+  Context* context = static_cast<Context*>(user_data);
+  {
+    // Holding the lock stops the pipeline being destroyed while the handler
+    // runs.
+    std::lock_guard<std::recursive_mutex> lock(context->mutex);
+    if (context->pipeline) (context->pipeline->*handler)(result);
+  }
+  Release(context);
+}
+
+void InvitesPipeline::Start(
+    std::chrono::steady_clock::time_point launch_time) {
+  launch_time_ = launch_time;
+  // Both stages are counted before either starts, as a stage may complete
+  // before the call that starts it returns.
+  Context* fetch_context = StartStage();
+  Context* send_context = StartStage();
+  // The fetch is on the path to routing the user, so it's started first.
+  LogMessage("Fetch: Fetching invites...");
+  receiver_->Fetch().OnCompletion(
+      Dispatch< ::firebase::invites::FetchResult, &InvitesPipeline::OnFetched>,
+      fetch_context);
+  LogMessage("SendInvite: Sending an invitation...");
+  sender_->SendInvite().OnCompletion(
+      Dispatch< ::firebase::invites::SendInviteResult,
+                &InvitesPipeline::OnSent>,
+      send_context);
+}
+
+void InvitesPipeline::OnFetched(
+    const ::firebase::Future< ::firebase::invites::FetchResult>&
+        future_result) {
+  if (future_result.Status() == firebase::kFutureStatusInvalid) {
+    LogMessage("Fetch: Invalid, sorry!");
+  } else if (future_result.Error() != 0) {
+    LogMessage("Fetch: Error %d: %s", future_result.Error(),
+               future_result.ErrorMessage());
+  } else {
+    const ::firebase::invites::FetchResult& result = *future_result.Result();
+    LogMessage("Fetch: Complete!");
+    if (result.deep_link != "") {
+      LogMessage("Fetch: Got deep link: %s", result.deep_link.c_str());
+      // Route the user without waiting for the conversion.
+      deep_link_handler_(result.deep_link);
+      std::lock_guard<std::mutex> lock(mutex_);
+      metrics_.deep_link_ms = Elapsed();
+    }
+    if (result.invitation_id != "") {
+      LogMessage("Fetch: Got invitation ID: %s",
+                 result.invitation_id.c_str());
+      if (ledger_ && ledger_->Contains(result.invitation_id)) {
+        LogMessage("ConvertInvitation: Invitation %s already converted, "
+                   "skipping",
+                   result.invitation_id.c_str());
+      } else {
+        LogMessage("ConvertInvitation: Converting invitation %s",
+                   result.invitation_id.c_str());
+        // Counted before starting, as it may complete before
+        // ConvertInvitation() returns.
+        Context* context = StartStage();
+        receiver_->ConvertInvitation(result.invitation_id.c_str())
+            .OnCompletion(
+                Dispatch< ::firebase::invites::ConvertInvitationResult,
+                          &InvitesPipeline::OnConverted>,
+                context);
+      }
+    }
+    if (result.invitation_id == "" && result.deep_link == "") {
+      LogMessage("Fetch: No invitation ID or deep link, confirmed.");
+    }
+  }
+  Complete(&metrics_.fetch_ms);
+}
+
+void InvitesPipeline::OnConverted(
+    const ::firebase::Future< ::firebase::invites::ConvertInvitationResult>&
+        future_result) {
+  if (future_result.Status() == firebase::kFutureStatusInvalid) {
+    LogMessage("ConvertInvitation: Invalid, sorry!");
+  } else if (future_result.Error() != 0) {
+    LogMessage("ConvertInvitation: Error %d: %s", future_result.Error(),
+               future_result.ErrorMessage());
+  } else {
+    const std::string& invitation_id = future_result.Result()->invitation_id;
+    LogMessage("ConvertInvitation: Successfully converted invitation ID: %s",
+               invitation_id.c_str());
+    if (ledger_) {
+      ledger_->Add(invitation_id);
+      if (!ledger_->Save()) {
+        LogMessage("ConvertInvitation: Failed to save the invitation ledger");
+      }
+    }
+  }
+  Complete(&metrics_.convert_ms);
+}
+
+void InvitesPipeline::OnSent(
+    const ::firebase::Future< ::firebase::invites::SendInviteResult>&
+        future_result) {
+  if (future_result.Status() == firebase::kFutureStatusInvalid) {
+    LogMessage("SendInvite: Invalid, sorry!");
+  } else if (future_result.Error() != 0) {
+    LogMessage("SendInvite: Error %d: %s", future_result.Error(),
+               future_result.ErrorMessage());
+  } else {
+    const ::firebase::invites::SendInviteResult& result =
+        *future_result.Result();
+    LogMessage("SendInvite: Complete!");
+    if (result.invitation_ids.size() == 0) {
+      LogMessage("SendInvite: Nothing sent, user must have canceled.");
+    } else {
+      LogMessage("SendInvite: %d invites sent successfully.",
+                 static_cast<int>(result.invitation_ids.size()));
+      for (size_t i = 0; i < result.invitation_ids.size(); i++) {
+        LogMessage("SendInvite: Invite code: %s",
+                   result.invitation_ids[i].c_str());
+      }
+    }
+  }
+  Complete(&metrics_.send_ms);
+}
+
+int64_t InvitesPipeline::Elapsed() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - launch_time_)
+      .count();
+}
+
+void InvitesPipeline::Complete(int64_t* stage_ms) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    *stage_ms = Elapsed();
+  }
+  pending_--;
+}
+
+InvitesPipeline::Metrics InvitesPipeline::GetMetrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return metrics_;
+}
+
+void InvitesPipeline::LogMetrics() const {
+  Metrics metrics = GetMetrics();
+  LogMessage("Latency from launch: fetch=%dms deep_link=%dms convert=%dms "
+             "send=%dms",
+             static_cast<int>(metrics.fetch_ms),
+             static_cast<int>(metrics.deep_link_ms),
+             static_cast<int>(metrics.convert_ms),
+             static_cast<int>(metrics.send_ms));
+}
@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_INVITES_PIPELINE_H_  // NOLINT
+#define FIREBASE_TESTAPP_INVITES_PIPELINE_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "firebase/future.h"
+#include "firebase/invites.h"
+#include "invitation_ledger.h"  // NOLINT
+
+// Receives and sends invitations as a chain of completion callbacks rather
+// than by polling each future in turn.
+//
+// Start() begins fetching received invitations and sending an invitation at
+// the same time.  When the fetch completes, a deep link is passed straight
+// to the app's handler, before the invitation is converted, so the user can
+// be routed as soon as possible after launch.  The invitation is then
+// converted from the fetch's completion callback, unless the ledger shows it
+// was converted by an earlier run of the app.
+//
+// Callbacks run on whichever thread the SDK completes futures on, so the
+// deep link handler must be thread safe.  The pipeline can be destroyed
+// before it's done, e.g. if the app exits, after which late completions are
+// ignored.
+class InvitesPipeline {
+ public:
+  // Called with the deep link of a received invitation.
+  typedef std::function<void(const std::string& deep_link)> DeepLinkHandler;
+
+  // Milliseconds from launch to the completion of each stage, or -1 if it
+  // hasn't completed or didn't run.
+  struct Metrics {
+    int64_t fetch_ms;
+    // When the deep link was passed to the handler.
+    int64_t deep_link_ms;
+    int64_t convert_ms;
+    int64_t send_ms;
+  };
+
+  // receiver, sender and ledger must outlive the pipeline.  The sender must
+  // be configured with the invitation to send before Start().  Converted
+  // invitations are recorded in the ledger, which may be null to convert
+  // every invitation.
+  InvitesPipeline(::firebase::invites::InvitesReceiver* receiver,
+                  ::firebase::invites::InvitesSender* sender,
+                  InvitationLedger* ledger,
+                  const DeepLinkHandler& deep_link_handler);
+  // Waits for a running completion callback to return, and detaches any
+  // stage still in progress so its callback does nothing.
+  ~InvitesPipeline();
+
+  // Start fetching and sending.  launch_time is when the app started, which
+  // latencies are measured from.
+  void Start(std::chrono::steady_clock::time_point launch_time);
+
+  // Whether every stage has completed.
+  bool Done() const { return pending_.load() == 0; }
+
+  Metrics GetMetrics() const;
+  void LogMetrics() const;
+
+ private:
+  // Passed to completion callbacks in place of the pipeline, so a callback
+  // that runs after the pipeline is destroyed can tell.
+  struct Context {
+    // Held while a callback runs.  Recursive as a stage can complete within
+    // the callback that starts it.
+    std::recursive_mutex mutex;
+    // Null once the pipeline is destroyed.
+    InvitesPipeline* pipeline;
+    // Held by the pipeline and by each callback that hasn't run.
+    int references;
+  };
+
+  InvitesPipeline(const InvitesPipeline&) = delete;
+  InvitesPipeline& operator=(const InvitesPipeline&) = delete;
+
+  // Add a reference to the context for a stage's callback, and count the
+  // stage as pending.
+  Context* StartStage();
+  static void Release(Context* context);
+  // Completion callback that passes the result to handler, unless the
+  // pipeline has been destroyed.
+  template <typename T, void (InvitesPipeline::*handler)(
+                            const ::firebase::Future<T>&)>
+  static void Dispatch(const ::firebase::Future<T>& result,
+                       void* user_data);
+
+  void OnFetched(
+      const ::firebase::Future< ::firebase::invites::FetchResult>& result);
+  void OnConverted(
+      const ::firebase::Future< ::firebase::invites::ConvertInvitationResult>&
+          result);
+  void OnSent(
+      const ::firebase::Future< ::firebase::invites::SendInviteResult>&
+          result);
+
+  // Milliseconds since launch.
+  int64_t Elapsed() const;
+  // Record the completion of a stage.
+  void Complete(int64_t* stage_ms);
+
+  ::firebase::invites::InvitesReceiver* receiver_;
+  ::firebase::invites::InvitesSender* sender_;
+  InvitationLedger* ledger_;
+  DeepLinkHandler deep_link_handler_;
+  std::chrono::steady_clock::time_point launch_time_;
+  Context* context_;
+  // Stages started but not completed.
+  std::atomic<int> pending_;
+  mutable std::mutex mutex_;
+  Metrics metrics_;
+};
+
+#endif  // FIREBASE_TESTAPP_INVITES_PIPELINE_H_  // NOLINT
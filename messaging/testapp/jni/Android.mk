@@ -39,6 +39,16 @@ include $(CLEAR_VARS)
 LOCAL_MODULE:=android_main
 LOCAL_SRC_FILES:=\
 	$(LOCAL_PATH)/src/common_main.cc \
+	$(LOCAL_PATH)/src/latency_histogram.cc \
+	$(LOCAL_PATH)/src/message_worker_pool.cc \
+	$(LOCAL_PATH)/src/flat_message.cc \
+	$(LOCAL_PATH)/src/file_util.cc \
+	$(LOCAL_PATH)/src/token_store.cc \
+	$(LOCAL_PATH)/src/topic_subscription_manager.cc \
+	$(LOCAL_PATH)/src/message_deduplicator.cc \
+	$(LOCAL_PATH)/src/message_listener.cc \
+	$(LOCAL_PATH)/src/message_journal.cc \
+	$(LOCAL_PATH)/src/message_router.cc \
 	$(LOCAL_PATH)/src/android/android_main.cc
 LOCAL_STATIC_LIBRARIES:=\
 	firebase_messaging \
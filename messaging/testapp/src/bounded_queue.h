@@ -0,0 +1,169 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_BOUNDED_QUEUE_H_  // NOLINT
+#define FIREBASE_TESTAPP_BOUNDED_QUEUE_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// What a BoundedQueue does when an item is pushed while it's full, and for
+// kOverflowCoalesce, when an item with the same key is already queued.
+enum OverflowPolicy {
+  // Block the producer until there is space.
+  kOverflowBlock,
+  // Discard the oldest queued item.
+  kOverflowDropOldest,
+  // On every push, whether or not the queue is full, replace a queued item
+  // with the same key as the new item, wherever it is in the queue, so only
+  // the latest version is processed.  Items without a queued match are
+  // handled as kOverflowDropOldest.
+  kOverflowCoalesce,
+};
+
+enum PushResult {
+  kPushQueued,
+  // The item was queued and the oldest item was discarded to make room.
+  kPushDroppedOldest,
+  // The item replaced a queued item with the same key.
+  kPushCoalesced,
+  // The queue is closed, the item was discarded.
+  kPushClosed,
+};
+
+// Bounded multi-producer, multi-consumer FIFO queue.
+template <typename T>
+class BoundedQueue {
+ public:
+  // Returns the key used to coalesce an item, or an empty string if the item
+  // can't be coalesced.
+  typedef std::function<std::string(const T& item)> KeyFunction;
+
+  BoundedQueue(size_t capacity, OverflowPolicy policy,
+               const KeyFunction& key_function = KeyFunction())
+      : capacity_(capacity ? capacity : 1),
+        policy_(policy),
+        key_function_(key_function),
+        front_sequence_(0),
+        closed_(false) {}
+
+  // Add an item to the back of the queue, applying the overflow policy if the
+  // queue is full.  With kOverflowCoalesce the item instead replaces a queued
+  // item with the same key, even if the queue isn't full, keeping that item's
+  // place in the queue.  If an item is dropped or replaced, it's moved to
+  // displaced when that's not null.
+  PushResult Push(T item, T* displaced = nullptr) {
+    std::string key;
+    if (policy_ == kOverflowCoalesce && key_function_) {
+      key = key_function_(item);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_) return kPushClosed;
+    if (!key.empty()) {
+      auto it = keys_.find(key);
+      if (it != keys_.end()) {
+        T& queued = items_[it->second - front_sequence_].second;
+        if (displaced) *displaced = std::move(queued);
+        queued = std::move(item);
+        return kPushCoalesced;
+      }
+    }
+    PushResult result = kPushQueued;
+    if (items_.size() >= capacity_) {
+      if (policy_ == kOverflowBlock) {
+        not_full_.wait(lock,
+                       [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return kPushClosed;
+      } else {
+        if (displaced) *displaced = std::move(items_.front().second);
+        PopFront();
+        result = kPushDroppedOldest;
+      }
+    }
+    const uint64_t sequence = front_sequence_ + items_.size();
+    if (!key.empty()) keys_[key] = sequence;
+    items_.push_back(std::make_pair(key, std::move(item)));
+    lock.unlock();
+    not_empty_.notify_one();
+    return result;
+  }
+
+  // Remove the item at the front of the queue, waiting for one to arrive if
+  // the queue is empty.  Returns false once the queue is closed and empty.
+  bool Pop(T* item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) return false;
+    *item = std::move(items_.front().second);
+    PopFront();
+    lock.unlock();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Stop accepting items and wake all waiting threads.  Items already queued
+  // can still be popped.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.size();
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  // Must be called with mutex_ held.
+  void PopFront() {
+    const std::string& key = items_.front().first;
+    if (!key.empty()) {
+      auto it = keys_.find(key);
+      if (it != keys_.end() && it->second == front_sequence_) keys_.erase(it);
+    }
+    items_.pop_front();
+    front_sequence_++;
+  }
+
+  const size_t capacity_;
+  const OverflowPolicy policy_;
+  const KeyFunction key_function_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  // Each item with its coalescing key.
+  std::deque<std::pair<std::string, T>> items_;
+  // Sequence number of each queued item with a key, where the item at the
+  // front of the queue has sequence number front_sequence_.
+  std::unordered_map<std::string, uint64_t> keys_;
+  uint64_t front_sequence_;
+  bool closed_;
+};
+
+#endif  // FIREBASE_TESTAPP_BOUNDED_QUEUE_H_  // NOLINT
@@ -21,45 +21,111 @@
 // Thin OS abstraction layer.
 #include "main.h"  // NOLINT
 
-class MessageListener : public firebase::messaging::Listener {
- public:
-  virtual void OnMessage(const ::firebase::messaging::Message& message) {
-    // When messages are received by the server, they are placed into an
-    // internal queue, waiting to be consumed. When ProcessMessages is called,
-    // this OnMessage function is called once for each queued message.
-    LogMessage("Recieved a new message");
-    if (!message.from.empty()) LogMessage("from: %s", message.from.c_str());
-    if (!message.data.empty()) {
-      LogMessage("data:");
-      typedef std::map<std::string, std::string>::const_iterator MapIter;
-      for (MapIter it = message.data.begin(); it != message.data.end(); ++it) {
-        LogMessage("  %s: %s", it->first.c_str(), it->second.c_str());
-      }
+#include "flat_message.h"  // NOLINT
+#include "latency_histogram.h"  // NOLINT
+#include "message_deduplicator.h"  // NOLINT
+#include "message_journal.h"  // NOLINT
+#include "message_listener.h"  // NOLINT
+#include "message_router.h"  // NOLINT
+#include "message_worker_pool.h"  // NOLINT
+#include "token_store.h"  // NOLINT
+#include "topic_subscription_manager.h"  // NOLINT
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+#include "desktop/messaging_benchmark.h"  // NOLINT
+#endif  // !defined(__ANDROID__) && !defined(__APPLE__)
+
+// Time common_main() started, used to measure how long the app waits for a
+// registration token.
+static int64_t g_start_time_ns;
+
+// Milliseconds since common_main() started.
+static double MillisecondsSinceStart() {
+  return static_cast<double>(LatencyHistogram::NowNanoseconds() -
+                             g_start_time_ns) /
+         1e6;
+}
+
+// Application handling of a received message.
+static void HandleMessage(const FlatMessage& message) {
+  LogMessage("Recieved a new message");
+  if (!message.from().empty()) LogMessage("from: %s", message.from().data);
+  if (message.data_size()) {
+    LogMessage("data:");
+    for (size_t i = 0; i < message.data_size(); ++i) {
+      LogMessage("  %s: %s", message.key(i).data, message.value(i).data);
     }
   }
+}
 
-  virtual void OnTokenReceived(const char* token) {
-    // To send a message to a specific instance of your app a registration token
-    // is required. These tokens are unique for each instance of the app. When
-    // messaging::Initialize is called, a request is sent to the Firebase Cloud
-    // Messaging server to generate a token. When that token is ready,
-    // OnTokenReceived will be called. The token should be cached locally so
-    // that a request doesn't need to be generated each time the app is started.
-    //
-    // Once a token is generated is should be sent to your app server, which can
-    // then use it to send messages to users.
-    LogMessage("Recieved Registration Token: %s", token);
-  }
-};
+// Routes each received message to the parts of the app interested in it.
+MessageRouter g_router;
+
+static void DispatchMessage(const FlatMessage& message) {
+  g_router.Dispatch(message);
+}
 
-MessageListener g_listener;
+MessageListener g_listener(DispatchMessage);
 
 // Execute all methods of the C++ Firebase Cloud Messaging API.
 extern "C" int common_main(int argc, const char* argv[]) {
   ::firebase::App* app;
+  g_start_time_ns = LatencyHistogram::NowNanoseconds();
+  g_listener.set_start_time_ns(g_start_time_ns);
+
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+  // On desktop the app can benchmark its message handling locally rather
+  // than running the sample.
+  if (MessagingBenchmarkRequested(argc, argv)) {
+    return RunMessagingBenchmark(argc, argv);
+  }
+#endif  // !defined(__ANDROID__) && !defined(__APPLE__)
 
   LogMessage("Initialize the Messaging library");
 
+  // Every message is handled by HandleMessage, other parts of the app can
+  // subscribe to just the topics they're interested in.
+  g_router.Subscribe("*", HandleMessage);
+  g_router.Subscribe("/topics/TestTopic", [](const FlatMessage& message) {
+    LogMessage("TestTopic message %s", message.message_id().data);
+  });
+
+  // Messages are journaled until they've been handled, so they aren't lost if
+  // the app is killed first.  The journal must outlive the worker pool, which
+  // marks messages done as it handles them.
+  MessageJournal journal(std::string(GetDataPath()) + "/fcm_journal",
+                         MessageJournal::Options());
+  g_listener.set_journal(&journal);
+
+  // Messages are handled on worker threads.  During a burst, such as when the
+  // app reconnects, a queued message is replaced by a newer message with the
+  // same collapse_key so only the latest is handled, and if the queue fills
+  // the oldest message is dropped.  High priority messages are handled by a
+  // separate worker so they aren't delayed by the burst.
+  MessageWorkerPool::Options pool_options;
+  pool_options.overflow = kOverflowCoalesce;
+  pool_options.journal = &journal;
+  MessageWorkerPool worker_pool(pool_options, DispatchMessage);
+  g_listener.set_worker_pool(&worker_pool);
+
+  // Remember the most recent messages across restarts of the app.
+  MessageDeduplicator::Options deduplicator_options;
+  deduplicator_options.path = std::string(GetDataPath()) + "/fcm_dedup";
+  MessageDeduplicator deduplicator(deduplicator_options);
+  g_listener.set_deduplicator(&deduplicator);
+
+  // Handle messages the app received but didn't finish handling last time
+  // it ran.
+  std::vector<MessageJournal::Unfinished> unfinished =
+      journal.TakeUnfinished();
+  if (!unfinished.empty()) {
+    LogMessage("Handling %d unfinished messages",
+               static_cast<int>(unfinished.size()));
+  }
+  for (size_t i = 0; i < unfinished.size(); ++i) {
+    g_listener.Dispatch(std::move(unfinished[i].message),
+                        unfinished[i].ticket);
+  }
+
 #if defined(__ANDROID__)
   app = ::firebase::App::Create(::firebase::AppOptions(), GetJniEnv(),
                                 GetActivity());
@@ -69,6 +135,38 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   LogMessage("Initialized Firebase App.");
 
+  // Load the token cached by a previous run of the app so that it's available
+  // immediately rather than when OnTokenReceived is called.
+  TokenStore token_store(std::string(GetDataPath()) + "/fcm_token",
+                         app->options().app_id());
+  if (token_store.Load()) {
+    LogMessage("Cached Registration Token: %s (after %.1fms)",
+               token_store.token().c_str(), MillisecondsSinceStart());
+  }
+  g_listener.set_token_store(&token_store);
+
+  // Only topics that weren't subscribed to by a previous run of the app are
+  // sent to the server.  Subscribe() doesn't report a result, so requests are
+  // considered successful once they've been handed to the library, which
+  // retries them itself.
+  TopicSubscriptionManager subscriptions(
+      std::string(GetDataPath()) + "/fcm_topics",
+      [](const std::string& topic, bool subscribe,
+         const TopicSubscriptionManager::CompletionCallback& complete) {
+        if (subscribe) {
+          ::firebase::messaging::Subscribe(topic.c_str());
+          LogMessage("Subscribed to %s", topic.c_str());
+        } else {
+          ::firebase::messaging::Unsubscribe(topic.c_str());
+          LogMessage("Unsubscribed from %s", topic.c_str());
+        }
+        complete(true);
+      },
+      TopicSubscriptionManager::Options());
+  subscriptions.SetDesiredTopics(
+      std::vector<std::string>(1, "/topics/TestTopic"));
+  g_listener.set_subscriptions(&subscriptions);
+
   ::firebase::InitResult init_result;
   bool try_again;
   do {
@@ -104,15 +202,24 @@ extern "C" int common_main(int argc, const char* argv[]) {
   }
   LogMessage("Initialized Firebase Cloud Messaging.");
 
-  ::firebase::messaging::Subscribe("/topics/TestTopic");
-  LogMessage("Subscribed to TestTopic");
+  if (subscriptions.Update()) LogMessage("Topic subscriptions up to date");
 
   bool done = false;
   while (!done) {
     // Process events so that the client doesn't hang.
     done = ProcessEvents(1000);
+    // Retry any subscription requests that failed.
+    subscriptions.Update();
   }
   ::firebase::messaging::Terminate();
+  g_listener.set_worker_pool(nullptr);
+  g_listener.set_deduplicator(nullptr);
+  g_listener.set_journal(nullptr);
+  g_listener.set_token_store(nullptr);
+  g_listener.set_subscriptions(nullptr);
+  worker_pool.LogMetrics();
+  deduplicator.LogMetrics();
+  journal.LogMetrics();
   delete app;
 
   return 0;
@@ -57,6 +57,9 @@ void LogMessage(const char* format, ...) {
   fflush(stdout);
 }
 
+// Files are stored in the current working directory.
+const char* GetDataPath() { return "."; }
+
 WindowContext GetWindowContext() { return nullptr; }
 
 int main(int argc, const char* argv[]) {
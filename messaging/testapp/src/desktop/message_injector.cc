@@ -0,0 +1,86 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "desktop/message_injector.h"  // NOLINT
+
+#include <stdio.h>
+
+#include <chrono>
+#include <thread>
+
+std::string DataKey(int index) {
+  char key[32];
+  snprintf(key, sizeof(key), "key_%03d", index);
+  return std::string(key);
+}
+
+::firebase::messaging::Message SynthesizeMessage(int index, int keys,
+                                                 int value_size) {
+  ::firebase::messaging::Message message;
+  message.from = "/topics/TestTopic";
+  char message_id[32];
+  snprintf(message_id, sizeof(message_id), "0:%d", index);
+  message.message_id = message_id;
+  for (int i = 0; i < keys; ++i) {
+    message.data[DataKey(i)] =
+        std::string(static_cast<size_t>(value_size), 'a' + (i + index) % 26);
+  }
+  return message;
+}
+
+MessageInjector::MessageInjector(const Options& options)
+    : options_(options),
+      messages_(static_cast<size_t>(options.threads > 0 ? options.threads
+                                                        : 1)) {
+  // Deal messages to threads in turn, so message i is delivered at about
+  // i / rate seconds whichever thread delivers it.
+  for (int i = 0; i < options_.messages; ++i) {
+    messages_[static_cast<size_t>(i) % messages_.size()].push_back(
+        SynthesizeMessage(i, options_.keys, options_.value_size));
+  }
+}
+
+int64_t MessageInjector::Run(::firebase::messaging::Listener* listener) {
+  latency_.Reset();
+  std::vector<std::thread> threads;
+  const int64_t start_ns = LatencyHistogram::NowNanoseconds();
+  for (size_t i = 0; i < messages_.size(); ++i) {
+    threads.push_back(std::thread(&MessageInjector::Deliver, this, listener,
+                                  static_cast<int>(i), start_ns));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+  return LatencyHistogram::NowNanoseconds() - start_ns;
+}
+
+void MessageInjector::Deliver(::firebase::messaging::Listener* listener,
+                              int thread, int64_t start_ns) {
+  const std::vector< ::firebase::messaging::Message>& messages =
+      messages_[static_cast<size_t>(thread)];
+  const int64_t num_threads = static_cast<int64_t>(messages_.size());
+  for (size_t i = 0; i < messages.size(); ++i) {
+    if (options_.rate > 0) {
+      // Deliver on schedule rather than waiting a fixed interval after each
+      // message, so a slow OnMessage() doesn't lower the offered rate.
+      const int64_t index = static_cast<int64_t>(i) * num_threads + thread;
+      const int64_t due_ns = start_ns + index * 1000000000LL / options_.rate;
+      const int64_t wait_ns = due_ns - LatencyHistogram::NowNanoseconds();
+      if (wait_ns > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wait_ns));
+      }
+    }
+    const int64_t call_ns = LatencyHistogram::NowNanoseconds();
+    listener->OnMessage(messages[i]);
+    latency_.Record(LatencyHistogram::NowNanoseconds() - call_ns);
+  }
+}
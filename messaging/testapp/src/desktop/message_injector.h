@@ -0,0 +1,74 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DESKTOP_MESSAGE_INJECTOR_H_  // NOLINT
+#define FIREBASE_TESTAPP_DESKTOP_MESSAGE_INJECTOR_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "firebase/messaging.h"
+
+#include "latency_histogram.h"  // NOLINT
+
+// Key of data entry index in synthesized messages.
+std::string DataKey(int index);
+
+// Create a message like one delivered by the SDK, with keys data entries of
+// value_size bytes each.
+::firebase::messaging::Message SynthesizeMessage(int index, int keys,
+                                                 int value_size);
+
+// Delivers synthesized messages to a messaging::Listener from several
+// threads, as if they were received from Firebase Cloud Messaging, so the
+// app's message handling can be benchmarked without a network connection.
+class MessageInjector {
+ public:
+  struct Options {
+    Options()
+        : messages(100000), threads(4), rate(0), keys(8), value_size(32) {}
+
+    int messages;
+    int threads;
+    // Target messages per second across all threads, or 0 to deliver
+    // messages as fast as the listener accepts them.
+    int rate;
+    int keys;
+    int value_size;
+  };
+
+  // Synthesize the messages, so the cost of creating them isn't measured by
+  // Run().
+  explicit MessageInjector(const Options& options);
+
+  // Call listener->OnMessage() for every message, returning when all have
+  // been delivered.  Returns the time taken in nanoseconds.
+  int64_t Run(::firebase::messaging::Listener* listener);
+
+  // Time taken by each OnMessage() call during Run().
+  const LatencyHistogram& latency() const { return latency_; }
+
+ private:
+  void Deliver(::firebase::messaging::Listener* listener, int thread,
+               int64_t start_ns);
+
+  const Options options_;
+  // Messages delivered by each thread.
+  std::vector<std::vector< ::firebase::messaging::Message>> messages_;
+  LatencyHistogram latency_;
+};
+
+#endif  // FIREBASE_TESTAPP_DESKTOP_MESSAGE_INJECTOR_H_  // NOLINT
@@ -0,0 +1,314 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "desktop/messaging_benchmark.h"  // NOLINT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "firebase/messaging.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+#include "desktop/allocation_counter.h"  // NOLINT
+#include "desktop/message_injector.h"  // NOLINT
+#include "flat_message.h"  // NOLINT
+#include "latency_histogram.h"  // NOLINT
+#include "message_deduplicator.h"  // NOLINT
+#include "message_journal.h"  // NOLINT
+#include "message_listener.h"  // NOLINT
+#include "message_router.h"  // NOLINT
+#include "message_worker_pool.h"  // NOLINT
+
+namespace {
+
+// Returns the value of --name=value from the command line or nullptr.
+const char* GetOption(int argc, const char* argv[], const char* name) {
+  const size_t length = strlen(name);
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], name, length) == 0 && argv[i][length] == '=') {
+      return argv[i] + length + 1;
+    }
+  }
+  return nullptr;
+}
+
+bool HasFlag(int argc, const char* argv[], const char* name) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], name) == 0) return true;
+  }
+  return false;
+}
+
+int GetIntOption(int argc, const char* argv[], const char* name,
+                 int default_value) {
+  const char* value = GetOption(argc, argv, name);
+  return value ? atoi(value) : default_value;
+}
+
+// Compare FlatMessage against copying a Message, as the app did before
+// queueing messages as FlatMessage.
+int RunFlatMessageBenchmark(int messages, int keys, int value_size) {
+  std::vector< ::firebase::messaging::Message> received;
+  received.reserve(static_cast<size_t>(messages));
+  for (int i = 0; i < messages; ++i) {
+    received.push_back(SynthesizeMessage(i, keys, value_size));
+  }
+  // Look up every key and one that isn't present.
+  std::vector<std::string> lookup_keys;
+  for (int i = 0; i <= keys; ++i) lookup_keys.push_back(DataKey(i));
+  const double lookups =
+      static_cast<double>(messages) * static_cast<double>(lookup_keys.size());
+
+  std::vector< ::firebase::messaging::Message> copies;
+  copies.reserve(received.size());
+  uint64_t allocations = AllocationCount();
+  int64_t start = LatencyHistogram::NowNanoseconds();
+  for (size_t i = 0; i < received.size(); ++i) copies.push_back(received[i]);
+  const int64_t map_copy_ns = LatencyHistogram::NowNanoseconds() - start;
+  const uint64_t map_allocations = AllocationCount() - allocations;
+
+  std::vector<FlatMessage> flat;
+  flat.reserve(received.size());
+  allocations = AllocationCount();
+  start = LatencyHistogram::NowNanoseconds();
+  for (size_t i = 0; i < received.size(); ++i) {
+    flat.push_back(FlatMessage(received[i]));
+  }
+  const int64_t flat_copy_ns = LatencyHistogram::NowNanoseconds() - start;
+  const uint64_t flat_allocations = AllocationCount() - allocations;
+
+  size_t found = 0;
+  start = LatencyHistogram::NowNanoseconds();
+  for (size_t i = 0; i < copies.size(); ++i) {
+    const std::map<std::string, std::string>& data = copies[i].data;
+    for (size_t k = 0; k < lookup_keys.size(); ++k) {
+      std::map<std::string, std::string>::const_iterator it =
+          data.find(lookup_keys[k]);
+      if (it != data.end()) found += it->second.size();
+    }
+  }
+  const int64_t map_lookup_ns = LatencyHistogram::NowNanoseconds() - start;
+
+  size_t flat_found = 0;
+  start = LatencyHistogram::NowNanoseconds();
+  for (size_t i = 0; i < flat.size(); ++i) {
+    for (size_t k = 0; k < lookup_keys.size(); ++k) {
+      StringView value;
+      if (flat[i].Find(lookup_keys[k], &value)) flat_found += value.size;
+    }
+  }
+  const int64_t flat_lookup_ns = LatencyHistogram::NowNanoseconds() - start;
+  if (found != flat_found) {
+    LogMessage("Benchmark: lookups disagree, map %d bytes, flat %d bytes",
+               static_cast<int>(found), static_cast<int>(flat_found));
+    return 1;
+  }
+
+  LogMessage("Benchmark: %d messages with %d keys of %d bytes", messages,
+             keys, value_size);
+  LogMessage("Benchmark: Message copy  %.1f allocations/message %.0f ns/message"
+             " %.1f ns/lookup",
+             static_cast<double>(map_allocations) / messages,
+             static_cast<double>(map_copy_ns) / messages,
+             static_cast<double>(map_lookup_ns) / lookups);
+  LogMessage("Benchmark: FlatMessage   %.1f allocations/message %.0f ns/message"
+             " %.1f ns/lookup, %d bytes/message",
+             static_cast<double>(flat_allocations) / messages,
+             static_cast<double>(flat_copy_ns) / messages,
+             static_cast<double>(flat_lookup_ns) / lookups,
+             static_cast<int>(flat[0].arena_size()));
+  return 0;
+}
+
+// Deliver synthesized messages through the app's MessageListener, with
+// duplicate suppression, a worker pool and optionally the journal, from
+// several threads.
+int RunInjectionBenchmark(const MessageInjector::Options& options,
+                          bool journal_messages) {
+  const char kJournalPath[] = "messaging_benchmark_journal";
+  remove(kJournalPath);
+  MessageJournal journal(kJournalPath, MessageJournal::Options());
+
+  // Stand-in for the app's handler, which reads every value of the message
+  // rather than logging it.
+  std::atomic<uint64_t> bytes_read(0);
+  MessageWorkerPool::Handler handler = [&bytes_read](
+      const FlatMessage& message) {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < message.data_size(); ++i) {
+      bytes += message.value(i).size;
+    }
+    bytes_read += bytes;
+  };
+  // Block rather than drop messages, so every message is handled.
+  MessageWorkerPool::Options pool_options;
+  pool_options.overflow = kOverflowBlock;
+  if (journal_messages) pool_options.journal = &journal;
+  MessageWorkerPool worker_pool(pool_options, handler);
+  MessageDeduplicator deduplicator((MessageDeduplicator::Options()));
+  MessageListener listener(handler);
+  listener.set_worker_pool(&worker_pool);
+  listener.set_deduplicator(&deduplicator);
+  if (journal_messages) listener.set_journal(&journal);
+
+  MessageInjector injector(options);
+  const uint64_t allocations = AllocationCount();
+  const int64_t start = LatencyHistogram::NowNanoseconds();
+  const int64_t inject_ns = injector.Run(&listener);
+  // Wait for the workers to handle every queued message.
+  MessageWorkerPool::Metrics metrics = worker_pool.GetMetrics();
+  while (metrics.processed + metrics.dropped + metrics.coalesced <
+         metrics.submitted) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    metrics = worker_pool.GetMetrics();
+  }
+  const int64_t elapsed_ns = LatencyHistogram::NowNanoseconds() - start;
+  const uint64_t message_allocations = AllocationCount() - allocations;
+
+  LogMessage("Benchmark: injected %d messages with %d keys of %d bytes from "
+             "%d threads, target rate %d/s", options.messages, options.keys,
+             options.value_size, options.threads, options.rate);
+  LogMessage("Benchmark: delivered %.0f messages/sec, handled %.0f "
+             "messages/sec, %.1f allocations/message",
+             options.messages / (static_cast<double>(inject_ns) / 1e9),
+             metrics.processed / (static_cast<double>(elapsed_ns) / 1e9),
+             static_cast<double>(message_allocations) / options.messages);
+  const LatencyHistogram& latency = injector.latency();
+  LogMessage("Benchmark: OnMessage latency p50=%lldns p99=%lldns "
+             "p99.9=%lldns",
+             static_cast<long long>(latency.Percentile(50)),  // NOLINT
+             static_cast<long long>(latency.Percentile(99)),  // NOLINT
+             static_cast<long long>(latency.Percentile(99.9)));  // NOLINT
+  LogMessage("Benchmark: handler latency p50=%lldns p99=%lldns",
+             static_cast<long long>(metrics.latency_p50_ns),  // NOLINT
+             static_cast<long long>(metrics.latency_p99_ns));  // NOLINT
+  deduplicator.LogMetrics();
+  if (journal_messages) journal.LogMetrics();
+  remove(kJournalPath);
+  return 0;
+}
+
+// Measure the cost of routing a message as the number of subscribers grows.
+// Each subscriber is interested in its own topic, so each message matches one
+// subscriber whichever way it's routed.
+int RunRouterBenchmark(int messages, int keys, int value_size) {
+  std::vector<FlatMessage> received;
+  for (int i = 0; i < 64; ++i) {
+    received.push_back(FlatMessage(SynthesizeMessage(i, keys, value_size)));
+  }
+  uint64_t called = 0;
+  MessageRouter::Subscriber subscriber = [&called](const FlatMessage&) {
+    called++;
+  };
+  LogMessage("Benchmark: %d messages with %d keys of %d bytes", messages,
+             keys, value_size);
+  for (int subscribers = 10; subscribers <= 100000; subscribers *= 10) {
+    MessageRouter router;
+    std::vector<std::string> topics;
+    for (int i = 0; i < subscribers; ++i) {
+      char topic[64];
+      snprintf(topic, sizeof(topic), "/topics/topic_%d", i);
+      topics.push_back(topic);
+      router.Subscribe(topic, subscriber);
+    }
+    // Messages are from topics spread over all subscribers.
+    for (size_t i = 0; i < received.size(); ++i) {
+      ::firebase::messaging::Message message = received[i].ToMessage();
+      message.from = topics[(i * 7919) % topics.size()];
+      received[i] = FlatMessage(message);
+    }
+
+    called = 0;
+    const uint64_t allocations = AllocationCount();
+    int64_t start = LatencyHistogram::NowNanoseconds();
+    for (int i = 0; i < messages; ++i) {
+      router.Dispatch(received[static_cast<size_t>(i) % received.size()]);
+    }
+    const int64_t router_ns = LatencyHistogram::NowNanoseconds() - start;
+    const uint64_t router_allocations = AllocationCount() - allocations;
+    const uint64_t router_called = called;
+
+    // Compare against checking every subscriber's topic.
+    called = 0;
+    start = LatencyHistogram::NowNanoseconds();
+    for (int i = 0; i < messages; ++i) {
+      const FlatMessage& message =
+          received[static_cast<size_t>(i) % received.size()];
+      for (size_t t = 0; t < topics.size(); ++t) {
+        if (message.from() == StringView(topics[t])) subscriber(message);
+      }
+    }
+    const int64_t scan_ns = LatencyHistogram::NowNanoseconds() - start;
+    if (called != router_called) {
+      LogMessage("Benchmark: router called %d subscribers, expected %d",
+                 static_cast<int>(router_called), static_cast<int>(called));
+      return 1;
+    }
+    LogMessage("Benchmark: %6d subscribers  router %.0f ns/message "
+               "%.1f allocations/message  linear scan %.0f ns/message",
+               subscribers, static_cast<double>(router_ns) / messages,
+               static_cast<double>(router_allocations) / messages,
+               static_cast<double>(scan_ns) / messages);
+  }
+  return 0;
+}
+
+}  // namespace
+
+bool MessagingBenchmarkRequested(int argc, const char* argv[]) {
+  return HasFlag(argc, argv, "--benchmark");
+}
+
+int RunMessagingBenchmark(int argc, const char* argv[]) {
+  const int messages = GetIntOption(argc, argv, "--messages", 100000);
+  const int keys = GetIntOption(argc, argv, "--keys", 8);
+  const int value_size = GetIntOption(argc, argv, "--value_size", 32);
+  if (messages <= 0 || keys < 0 || value_size < 0) {
+    LogMessage("Benchmark: --messages must be positive, --keys and "
+               "--value_size must not be negative");
+    return 1;
+  }
+  if (HasFlag(argc, argv, "--flat_message")) {
+    return RunFlatMessageBenchmark(messages, keys, value_size);
+  }
+  if (HasFlag(argc, argv, "--router")) {
+    return RunRouterBenchmark(messages, keys, value_size);
+  }
+  if (HasFlag(argc, argv, "--inject")) {
+    MessageInjector::Options options;
+    options.messages = messages;
+    options.keys = keys;
+    options.value_size = value_size;
+    options.threads = GetIntOption(argc, argv, "--threads", options.threads);
+    options.rate = GetIntOption(argc, argv, "--rate", options.rate);
+    if (options.threads <= 0 || options.rate < 0) {
+      LogMessage("Benchmark: --threads must be positive, --rate must not be "
+                 "negative");
+      return 1;
+    }
+    return RunInjectionBenchmark(options, HasFlag(argc, argv, "--journal"));
+  }
+  LogMessage("Benchmark: specify a benchmark, e.g. --flat_message, "
+             "--inject or --router");
+  return 1;
+}
@@ -0,0 +1,43 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DESKTOP_MESSAGING_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_DESKTOP_MESSAGING_BENCHMARK_H_  // NOLINT
+
+// Returns true if the command line asks for a benchmark to be run instead of
+// the sample, i.e. contains --benchmark.
+bool MessagingBenchmarkRequested(int argc, const char* argv[]);
+
+// Run the benchmark selected on the command line.
+//
+// Options:
+//   --flat_message   Compare allocations per message and lookup cost of
+//                    FlatMessage against Message::data.
+//   --inject         Deliver messages to the app's MessageListener from
+//                    several threads and report throughput, latency and
+//                    allocations per message.
+//   --threads=N      Threads delivering messages with --inject (default 4).
+//   --rate=N         Target messages per second with --inject, 0 for as fast
+//                    as possible (default 0).
+//   --journal        Journal messages with --inject.
+//   --router         Compare the cost of routing messages to 10 to 100000
+//                    subscribers with checking every subscriber.
+//   --messages=N     Number of messages to process (default 100000).
+//   --keys=N         Number of data entries per message (default 8).
+//   --value_size=N   Size in bytes of each data value (default 32).
+//
+// Returns 0 on success, non-zero if the options are invalid.
+int RunMessagingBenchmark(int argc, const char* argv[]);
+
+#endif  // FIREBASE_TESTAPP_DESKTOP_MESSAGING_BENCHMARK_H_  // NOLINT
@@ -0,0 +1,37 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_FILE_UTIL_H_  // NOLINT
+#define FIREBASE_TESTAPP_FILE_UTIL_H_  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+// Helpers shared by the classes that keep their state in small text files in
+// the app's data directory.
+
+// Read a line without the trailing newline.  Returns false at end of file.
+bool ReadLine(FILE* file, std::string* line);
+
+// Milliseconds since the epoch, for times saved to a file and compared by a
+// later run of the app.
+int64_t WallClockMilliseconds();
+
+// Milliseconds on a clock that never goes backwards, for scheduling within a
+// run of the app.
+int64_t SteadyClockMilliseconds();
+
+#endif  // FIREBASE_TESTAPP_FILE_UTIL_H_  // NOLINT
@@ -0,0 +1,169 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flat_message.h"  // NOLINT
+
+#include <map>
+
+int StringView::Compare(const StringView& other) const {
+  const size_t length = size < other.size ? size : other.size;
+  int result = length ? memcmp(data, other.data, length) : 0;
+  if (result != 0) return result;
+  return size < other.size ? -1 : (size > other.size ? 1 : 0);
+}
+
+FlatMessage::FlatMessage() {}
+
+FlatMessage::FlatMessage(const ::firebase::messaging::Message& message) {
+  typedef std::map<std::string, std::string>::const_iterator MapIter;
+  const std::string* fields[kNumFields];
+  fields[kFieldFrom] = &message.from;
+  fields[kFieldTo] = &message.to;
+  fields[kFieldCollapseKey] = &message.collapse_key;
+  fields[kFieldMessageId] = &message.message_id;
+  fields[kFieldMessageType] = &message.message_type;
+  fields[kFieldPriority] = &message.priority;
+  fields[kFieldError] = &message.error;
+  fields[kFieldErrorDescription] = &message.error_description;
+
+  // Size the arena so it's allocated exactly once.
+  size_t size = sizeof(Header) + message.data.size() * sizeof(Entry);
+  for (int i = 0; i < kNumFields; ++i) size += fields[i]->size() + 1;
+  for (MapIter it = message.data.begin(); it != message.data.end(); ++it) {
+    size += it->first.size() + 1 + it->second.size() + 1;
+  }
+  arena_.reset(new char[size]);
+
+  char* arena = arena_.get();
+  uint32_t offset = static_cast<uint32_t>(sizeof(Header) +
+                                          message.data.size() * sizeof(Entry));
+  auto append = [arena, &offset](const std::string& str) {
+    Span span;
+    span.offset = offset;
+    span.size = static_cast<uint32_t>(str.size());
+    memcpy(arena + offset, str.c_str(), str.size() + 1);
+    offset += span.size + 1;
+    return span;
+  };
+
+  Header* header = reinterpret_cast<Header*>(arena);
+  header->arena_size = static_cast<uint32_t>(size);
+  header->num_entries = static_cast<uint32_t>(message.data.size());
+  header->time_to_live = message.time_to_live;
+  header->flags = message.notification_opened ? kFlagNotificationOpened : 0;
+  for (int i = 0; i < kNumFields; ++i) header->fields[i] = append(*fields[i]);
+  // std::map iterates in key order, so the entry table is already sorted.
+  Entry* entry = reinterpret_cast<Entry*>(arena + sizeof(Header));
+  for (MapIter it = message.data.begin(); it != message.data.end();
+       ++it, ++entry) {
+    entry->key = append(it->first);
+    entry->value = append(it->second);
+  }
+}
+
+FlatMessage::FlatMessage(const FlatMessage& other) { *this = other; }
+
+FlatMessage::FlatMessage(FlatMessage&& other)
+    : arena_(std::move(other.arena_)) {}
+
+FlatMessage& FlatMessage::operator=(const FlatMessage& other) {
+  if (this != &other) {
+    if (other.arena_) {
+      const size_t size = other.arena_size();
+      arena_.reset(new char[size]);
+      memcpy(arena_.get(), other.arena_.get(), size);
+    } else {
+      arena_.reset();
+    }
+  }
+  return *this;
+}
+
+FlatMessage& FlatMessage::operator=(FlatMessage&& other) {
+  arena_ = std::move(other.arena_);
+  return *this;
+}
+
+bool FlatMessage::FromArena(const char* data, size_t size,
+                            FlatMessage* message) {
+  if (size < sizeof(Header)) return false;
+  Header header;
+  memcpy(&header, data, sizeof(header));
+  if (header.arena_size != size ||
+      header.num_entries > (size - sizeof(Header)) / sizeof(Entry)) {
+    return false;
+  }
+  // Every string must be inside the arena and null terminated.
+  auto valid = [data, size](const Span& span) {
+    return span.offset <= size && span.size < size - span.offset &&
+           data[span.offset + span.size] == '\0';
+  };
+  for (int i = 0; i < kNumFields; ++i) {
+    if (!valid(header.fields[i])) return false;
+  }
+  for (uint32_t i = 0; i < header.num_entries; ++i) {
+    Entry entry;
+    memcpy(&entry, data + sizeof(Header) + i * sizeof(Entry), sizeof(entry));
+    if (!valid(entry.key) || !valid(entry.value)) return false;
+  }
+  message->arena_.reset(new char[size]);
+  memcpy(message->arena_.get(), data, size);
+  return true;
+}
+
+StringView FlatMessage::key(size_t i) const {
+  return GetSpan(entries()[i].key);
+}
+
+StringView FlatMessage::value(size_t i) const {
+  return GetSpan(entries()[i].value);
+}
+
+bool FlatMessage::Find(const StringView& key, StringView* value) const {
+  const Entry* table = entries();
+  size_t low = 0;
+  size_t high = data_size();
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    int compare = GetSpan(table[middle].key).Compare(key);
+    if (compare == 0) {
+      if (value) *value = GetSpan(table[middle].value);
+      return true;
+    }
+    if (compare < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return false;
+}
+
+::firebase::messaging::Message FlatMessage::ToMessage() const {
+  ::firebase::messaging::Message message;
+  message.from = from().ToString();
+  message.to = to().ToString();
+  message.collapse_key = collapse_key().ToString();
+  message.message_id = message_id().ToString();
+  message.message_type = message_type().ToString();
+  message.priority = priority().ToString();
+  message.time_to_live = time_to_live();
+  message.error = error().ToString();
+  message.error_description = error_description().ToString();
+  message.notification_opened = notification_opened();
+  for (size_t i = 0; i < data_size(); ++i) {
+    message.data[key(i).ToString()] = value(i).ToString();
+  }
+  return message;
+}
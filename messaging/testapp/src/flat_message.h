@@ -0,0 +1,156 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_FLAT_MESSAGE_H_  // NOLINT
+#define FIREBASE_TESTAPP_FLAT_MESSAGE_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+
+#include "firebase/messaging.h"
+
+// Non-owning reference to a string.  Strings referenced from a FlatMessage
+// are also null terminated, so data can be passed to C APIs.
+struct StringView {
+  StringView() : data(""), size(0) {}
+  StringView(const char* str) : data(str), size(strlen(str)) {}  // NOLINT
+  StringView(const char* str, size_t length) : data(str), size(length) {}
+  StringView(const std::string& str)  // NOLINT
+      : data(str.c_str()), size(str.size()) {}
+
+  bool empty() const { return size == 0; }
+  std::string ToString() const { return std::string(data, size); }
+  int Compare(const StringView& other) const;
+  bool operator==(const StringView& other) const { return Compare(other) == 0; }
+  bool operator<(const StringView& other) const { return Compare(other) < 0; }
+
+  const char* data;
+  size_t size;
+};
+
+// Compact, immutable copy of a messaging::Message.
+//
+// Message::data is a std::map so each received message is a tree of nodes
+// and strings, each separately allocated.  A FlatMessage stores all of the
+// message's strings in a single arena allocation, preceded by a table of
+// offsets to each data entry sorted by key, so a key is found with a binary
+// search over contiguous memory and moving a FlatMessage is a pointer copy.
+class FlatMessage {
+ public:
+  FlatMessage();
+  explicit FlatMessage(const ::firebase::messaging::Message& message);
+  FlatMessage(const FlatMessage& other);
+  FlatMessage(FlatMessage&& other);
+  FlatMessage& operator=(const FlatMessage& other);
+  FlatMessage& operator=(FlatMessage&& other);
+
+  StringView from() const { return GetField(kFieldFrom); }
+  StringView to() const { return GetField(kFieldTo); }
+  StringView collapse_key() const { return GetField(kFieldCollapseKey); }
+  StringView message_id() const { return GetField(kFieldMessageId); }
+  StringView message_type() const { return GetField(kFieldMessageType); }
+  StringView priority() const { return GetField(kFieldPriority); }
+  StringView error() const { return GetField(kFieldError); }
+  StringView error_description() const {
+    return GetField(kFieldErrorDescription);
+  }
+  int32_t time_to_live() const {
+    return header() ? header()->time_to_live : 0;
+  }
+  bool notification_opened() const {
+    return header() && (header()->flags & kFlagNotificationOpened) != 0;
+  }
+
+  // Number of entries in the message's data.
+  size_t data_size() const { return header() ? header()->num_entries : 0; }
+  // Key and value of data entry i, in ascending key order.
+  StringView key(size_t i) const;
+  StringView value(size_t i) const;
+  // Look up the value of key in the message's data, returning false if the
+  // key is not present.
+  bool Find(const StringView& key, StringView* value) const;
+
+  // Convert back to a messaging::Message.
+  ::firebase::messaging::Message ToMessage() const;
+
+  // The arena holding the whole message, which only contains offsets so it
+  // can be written to a file and read back with FromArena().
+  const char* arena() const { return arena_.get(); }
+  // Number of bytes in the arena.
+  size_t arena_size() const { return header() ? header()->arena_size : 0; }
+
+  // Copy a message from size bytes of arena data written by another
+  // FlatMessage.  Returns false if the data is not a valid arena.
+  static bool FromArena(const char* data, size_t size, FlatMessage* message);
+
+ private:
+  enum Field {
+    kFieldFrom,
+    kFieldTo,
+    kFieldCollapseKey,
+    kFieldMessageId,
+    kFieldMessageType,
+    kFieldPriority,
+    kFieldError,
+    kFieldErrorDescription,
+    kNumFields,
+  };
+
+  enum Flag {
+    kFlagNotificationOpened = 1,
+  };
+
+  // A string in the arena, as an offset from the start of the arena.
+  struct Span {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  struct Entry {
+    Span key;
+    Span value;
+  };
+
+  // Start of the arena, followed by num_entries Entry structures then the
+  // null terminated strings.
+  struct Header {
+    uint32_t arena_size;
+    uint32_t num_entries;
+    int32_t time_to_live;
+    // Flag values.
+    uint32_t flags;
+    Span fields[kNumFields];
+  };
+
+  const Header* header() const {
+    return reinterpret_cast<const Header*>(arena_.get());
+  }
+  const Entry* entries() const {
+    return reinterpret_cast<const Entry*>(arena_.get() + sizeof(Header));
+  }
+  StringView GetSpan(const Span& span) const {
+    return StringView(arena_.get() + span.offset, span.size);
+  }
+  StringView GetField(Field field) const {
+    return header() ? GetSpan(header()->fields[field]) : StringView();
+  }
+
+  std::unique_ptr<char[]> arena_;
+};
+
+#endif  // FIREBASE_TESTAPP_FLAT_MESSAGE_H_  // NOLINT
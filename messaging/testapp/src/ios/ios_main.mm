@@ -15,6 +15,7 @@
 #import <UIKit/UIKit.h>
 
 #include <stdarg.h>
+#include <string.h>
 
 #include "main.h"
 
@@ -62,6 +63,18 @@ WindowContext GetWindowContext() {
   return g_parent_view;
 }
 
+// Get the app's Documents directory.
+const char* GetDataPath() {
+  static const char* path = nullptr;
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    NSArray *paths =
+        NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES);
+    path = strdup([paths.firstObject UTF8String]);
+  });
+  return path;
+}
+
 // Log a message that can be viewed in the console.
 void LogMessage(const char* format, ...) {
   va_list args;
@@ -0,0 +1,72 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "latency_histogram.h"  // NOLINT
+
+#include <chrono>
+
+LatencyHistogram::LatencyHistogram() { Reset(); }
+
+void LatencyHistogram::Record(int64_t nanoseconds) {
+  // Bucket i holds latencies in [2^(i-1), 2^i).
+  uint64_t value = nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0;
+  int bucket = 0;
+  while (value && bucket < kNumBuckets - 1) {
+    value >>= 1;
+    bucket++;
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+  uint64_t total = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    total += buckets_[i].load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+int64_t LatencyHistogram::Percentile(double percentile) const {
+  uint64_t counts[kNumBuckets];
+  uint64_t total = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) return 0;
+  uint64_t rank = static_cast<uint64_t>(static_cast<double>(total) *
+                                        percentile / 100.0);
+  if (rank >= total) rank = total - 1;
+  uint64_t seen = 0;
+  int i = 0;
+  for (; i < kNumBuckets; ++i) {
+    seen += counts[i];
+    if (seen > rank) break;
+  }
+  if (i == 0) return 0;
+  if (i >= 63) return INT64_MAX;
+  return (static_cast<int64_t>(1) << i) - 1;
+}
+
+void LatencyHistogram::Reset() {
+  for (int i = 0; i < kNumBuckets; ++i) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+int64_t LatencyHistogram::NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
@@ -0,0 +1,48 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_LATENCY_HISTOGRAM_H_  // NOLINT
+#define FIREBASE_TESTAPP_LATENCY_HISTOGRAM_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Lock-free histogram of latencies with power of two buckets, so it can be
+// updated from many threads on a hot path.  Percentiles are accurate to
+// within a factor of two.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  // Record a latency in nanoseconds.
+  void Record(int64_t nanoseconds);
+
+  // Number of latencies recorded.
+  uint64_t count() const;
+  // Upper bound of the bucket containing the given percentile (0..100) in
+  // nanoseconds, or 0 if nothing has been recorded.
+  int64_t Percentile(double percentile) const;
+  // Discard all recorded latencies.
+  void Reset();
+
+  // Nanoseconds since an arbitrary epoch, from a monotonic clock.
+  static int64_t NowNanoseconds();
+
+ private:
+  static const int kNumBuckets = 64;
+  std::atomic<uint64_t> buckets_[kNumBuckets];
+};
+
+#endif  // FIREBASE_TESTAPP_LATENCY_HISTOGRAM_H_  // NOLINT
@@ -55,6 +55,10 @@ JNIEnv* GetJniEnv();
 jobject GetActivity();
 #endif  // defined(__ANDROID__)
 
+// Returns the path of a directory private to the app where it can store files
+// that persist between runs of the app.
+const char* GetDataPath();
+
 // Returns a variable that describes the window context for the app. On Android
 // this will be a jobject pointing to the Activity. On iOS, it's an id pointing
 // to the root view of the view controller.
@@ -0,0 +1,282 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_deduplicator.h"  // NOLINT
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // !defined(_WIN32)
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+namespace {
+
+const char kMagic[8] = {'f', 'c', 'm', 'd', 'e', 'd', 'u', 'p'};
+// Changed if the file format or hash functions change.
+const uint32_t kVersion = 1;
+const uint32_t kMaxHashes = 16;
+
+uint64_t Fnv1a(uint64_t hash, const StringView& str) {
+  for (size_t i = 0; i < str.size; ++i) {
+    hash ^= static_cast<uint8_t>(str.data[i]);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Finalizer from splitmix64, used to derive a second independent hash.
+uint64_t Mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+}  // namespace
+
+// Start of the storage, followed by the two filters.
+struct MessageDeduplicator::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_hashes;
+  uint64_t num_words;
+  uint64_t capacity;
+  // Index (0 or 1) of the filter ids are added to.
+  uint64_t current;
+  // Number of ids added to the current filter.
+  uint64_t count;
+};
+
+MessageDeduplicator::MessageDeduplicator(const Options& options)
+    : path_(options.path),
+      capacity_(options.capacity ? options.capacity : 1),
+      storage_(nullptr),
+      mapped_(false),
+      header_(nullptr),
+      checked_(0),
+      duplicates_(0),
+      unidentified_(0),
+      rotations_(0) {
+  // A lookup checks both filters, so each gets half the false positive
+  // budget.  The optimal filter for n ids with false positive rate p has
+  // -n ln(p) / ln(2)^2 bits and (bits / n) ln(2) hash functions.
+  double rate = options.false_positive_rate;
+  if (rate <= 0.0 || rate >= 1.0) rate = 0.001;
+  const double ln2 = log(2.0);
+  const double bits =
+      ceil(-static_cast<double>(capacity_) * log(rate / 2) / (ln2 * ln2));
+  num_words_ = static_cast<size_t>(ceil(bits / 64));
+  const double hashes = floor(bits / capacity_ * ln2 + 0.5);
+  num_hashes_ = static_cast<uint32_t>(hashes < 1 ? 1 : hashes);
+  if (num_hashes_ > kMaxHashes) num_hashes_ = kMaxHashes;
+  storage_size_ = sizeof(Header) + 2 * num_words_ * sizeof(uint64_t);
+  Open();
+}
+
+MessageDeduplicator::~MessageDeduplicator() { Close(); }
+
+void MessageDeduplicator::GetBits(const StringView& sender,
+                                  const StringView& message_id,
+                                  uint64_t* bits) const {
+  uint64_t hash = Fnv1a(0xcbf29ce484222325ULL, sender);
+  hash = Fnv1a(hash ^ 0xff, message_id);
+  const uint64_t step = Mix(hash) | 1;
+  const uint64_t num_bits = num_words_ * 64;
+  for (uint32_t i = 0; i < num_hashes_; ++i) {
+    bits[i] = (hash + i * step) % num_bits;
+  }
+}
+
+bool MessageDeduplicator::InFilter(uint64_t index,
+                                   const uint64_t* bits) const {
+  const uint64_t* filter = generation(index);
+  for (uint32_t i = 0; i < num_hashes_; ++i) {
+    if (!(filter[bits[i] >> 6] & (1ULL << (bits[i] & 63)))) return false;
+  }
+  return true;
+}
+
+bool MessageDeduplicator::Contains(const StringView& sender,
+                                   const StringView& message_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  checked_++;
+  if (message_id.empty()) {
+    unidentified_++;
+    return false;
+  }
+  uint64_t bits[kMaxHashes];
+  GetBits(sender, message_id, bits);
+  if (InFilter(header_->current, bits)) {
+    duplicates_++;
+    return true;
+  }
+  if (InFilter(header_->current ^ 1, bits)) {
+    // It was inserted before, so it's added to the current filter to be
+    // remembered after the previous filter is cleared.
+    AddLocked(bits);
+    duplicates_++;
+    return true;
+  }
+  return false;
+}
+
+void MessageDeduplicator::Insert(const StringView& sender,
+                                 const StringView& message_id) {
+  if (message_id.empty()) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t bits[kMaxHashes];
+  GetBits(sender, message_id, bits);
+  if (!InFilter(header_->current, bits)) AddLocked(bits);
+}
+
+void MessageDeduplicator::AddLocked(const uint64_t* bits) {
+  if (header_->count >= capacity_) {
+    header_->current ^= 1;
+    header_->count = 0;
+    memset(generation(header_->current), 0, num_words_ * sizeof(uint64_t));
+    rotations_++;
+  }
+  uint64_t* current = generation(header_->current);
+  for (uint32_t i = 0; i < num_hashes_; ++i) {
+    current[bits[i] >> 6] |= 1ULL << (bits[i] & 63);
+  }
+  header_->count++;
+}
+
+MessageDeduplicator::Metrics MessageDeduplicator::GetMetrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Metrics metrics;
+  metrics.checked = checked_;
+  metrics.duplicates = duplicates_;
+  metrics.unidentified = unidentified_;
+  metrics.rotations = rotations_;
+  metrics.memory_bytes = storage_size_;
+  metrics.persistent = !path_.empty();
+  return metrics;
+}
+
+void MessageDeduplicator::LogMetrics() const {
+  Metrics metrics = GetMetrics();
+  LogMessage(
+      "MessageDeduplicator: checked=%d duplicates=%d unidentified=%d "
+      "rotations=%d memory=%dbytes hashes=%d%s",
+      static_cast<int>(metrics.checked), static_cast<int>(metrics.duplicates),
+      static_cast<int>(metrics.unidentified),
+      static_cast<int>(metrics.rotations),
+      static_cast<int>(metrics.memory_bytes), static_cast<int>(num_hashes_),
+      metrics.persistent ? " persistent" : "");
+}
+
+uint64_t* MessageDeduplicator::generation(uint64_t index) const {
+  return reinterpret_cast<uint64_t*>(storage_ + sizeof(Header)) +
+         index * num_words_;
+}
+
+#if !defined(_WIN32)
+
+void MessageDeduplicator::Open() {
+  if (!path_.empty()) {
+    int fd = open(path_.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd >= 0) {
+      struct stat status;
+      // Resize the file if it was created with different options; it's
+      // reinitialized below.
+      if (fstat(fd, &status) == 0 &&
+          (static_cast<size_t>(status.st_size) == storage_size_ ||
+           ftruncate(fd, storage_size_) == 0)) {
+        void* mapping = mmap(nullptr, storage_size_, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+          storage_ = static_cast<char*>(mapping);
+          mapped_ = true;
+        }
+      }
+      close(fd);
+    }
+    if (!mapped_) {
+      LogMessage("MessageDeduplicator: failed to map %s", path_.c_str());
+      path_.clear();
+    }
+  }
+  if (!storage_) storage_ = new char[storage_size_]();
+  Initialize();
+}
+
+void MessageDeduplicator::Close() {
+  if (mapped_) {
+    munmap(storage_, storage_size_);
+  } else {
+    delete[] storage_;
+  }
+  storage_ = nullptr;
+  header_ = nullptr;
+}
+
+#else
+
+// Windows doesn't have mmap(), so the filters are read into memory when
+// opened and written back when closed.
+void MessageDeduplicator::Open() {
+  storage_ = new char[storage_size_]();
+  if (!path_.empty()) {
+    FILE* file = fopen(path_.c_str(), "rb");
+    if (file) {
+      if (fread(storage_, 1, storage_size_, file) != storage_size_) {
+        memset(storage_, 0, storage_size_);
+      }
+      fclose(file);
+    }
+  }
+  Initialize();
+}
+
+void MessageDeduplicator::Close() {
+  if (!path_.empty()) {
+    FILE* file = fopen(path_.c_str(), "wb");
+    bool written = file && fwrite(storage_, 1, storage_size_, file) ==
+                               storage_size_;
+    if (file) written = fclose(file) == 0 && written;
+    if (!written) {
+      LogMessage("MessageDeduplicator: failed to write %s", path_.c_str());
+    }
+  }
+  delete[] storage_;
+  storage_ = nullptr;
+  header_ = nullptr;
+}
+
+#endif  // !defined(_WIN32)
+
+void MessageDeduplicator::Initialize() {
+  header_ = reinterpret_cast<Header*>(storage_);
+  if (memcmp(header_->magic, kMagic, sizeof(kMagic)) == 0 &&
+      header_->version == kVersion && header_->num_hashes == num_hashes_ &&
+      header_->num_words == num_words_ && header_->capacity == capacity_ &&
+      header_->current <= 1) {
+    return;
+  }
+  memset(storage_, 0, storage_size_);
+  memcpy(header_->magic, kMagic, sizeof(kMagic));
+  header_->version = kVersion;
+  header_->num_hashes = num_hashes_;
+  header_->num_words = num_words_;
+  header_->capacity = capacity_;
+}
@@ -0,0 +1,114 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_MESSAGE_DEDUPLICATOR_H_  // NOLINT
+#define FIREBASE_TESTAPP_MESSAGE_DEDUPLICATOR_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+
+#include "flat_message.h"  // NOLINT
+
+// Detects messages that have already been delivered, e.g. redelivered after
+// the app restarts, so that handlers which aren't idempotent only see each
+// message once.
+//
+// Messages are identified by sender and message_id and remembered in a
+// rotating pair of Bloom filters: ids are added to the current filter and
+// looked up in both, and when the current filter holds capacity ids the older
+// filter is cleared and becomes the current one.  So at least the last
+// capacity messages are remembered using a fixed amount of memory however
+// long the app runs.  Like any Bloom filter, a new message is occasionally
+// mistaken for a duplicate, at roughly false_positive_rate.
+//
+// The filters can be kept in a memory mapped file so they survive restarts.
+//
+// All methods are thread safe.
+class MessageDeduplicator {
+ public:
+  struct Options {
+    Options() : capacity(10000), false_positive_rate(0.001) {}
+
+    // Number of messages held by each filter.
+    size_t capacity;
+    // Probability that a new message is reported as a duplicate.
+    double false_positive_rate;
+    // File used to persist the filters, or empty to keep them in memory.
+    std::string path;
+  };
+
+  struct Metrics {
+    uint64_t checked;
+    uint64_t duplicates;
+    // Messages without a message_id, which can't be deduplicated.
+    uint64_t unidentified;
+    uint64_t rotations;
+    size_t memory_bytes;
+    bool persistent;
+  };
+
+  explicit MessageDeduplicator(const Options& options);
+  ~MessageDeduplicator();
+
+  // Returns true if the message from sender with message_id has been
+  // inserted before.  Messages without a message_id are never duplicates.
+  bool Contains(const StringView& sender, const StringView& message_id);
+  // Remember the message from sender with message_id.  Messages should only
+  // be inserted once they're durable, e.g. journaled, as a message that has
+  // been inserted is discarded if it's redelivered.
+  void Insert(const StringView& sender, const StringView& message_id);
+
+  Metrics GetMetrics() const;
+  void LogMetrics() const;
+
+ private:
+  struct Header;
+
+  // Point header_ and bits_ at storage_ or a mapped file.
+  void Open();
+  void Close();
+  // Reset the filters if the storage doesn't hold filters of this size.
+  void Initialize();
+  uint64_t* generation(uint64_t index) const;
+  // Index of each of the message's bits in a filter.
+  void GetBits(const StringView& sender, const StringView& message_id,
+               uint64_t* bits) const;
+  // Whether every one of bits is set in filter index.  Must be called with
+  // mutex_ held.
+  bool InFilter(uint64_t index, const uint64_t* bits) const;
+  // Set bits in the current filter, rotating the filters if it's full.  Must
+  // be called with mutex_ held.
+  void AddLocked(const uint64_t* bits);
+
+  std::string path_;
+  size_t num_words_;
+  size_t storage_size_;
+  uint32_t num_hashes_;
+  uint64_t capacity_;
+
+  mutable std::mutex mutex_;
+  // Either the mapped file or heap memory.
+  char* storage_;
+  bool mapped_;
+  Header* header_;
+  uint64_t checked_;
+  uint64_t duplicates_;
+  uint64_t unidentified_;
+  uint64_t rotations_;
+};
+
+#endif  // FIREBASE_TESTAPP_MESSAGE_DEDUPLICATOR_H_  // NOLINT
@@ -0,0 +1,331 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_journal.h"  // NOLINT
+
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // !defined(_WIN32)
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+namespace {
+
+const char kMagic[8] = {'f', 'c', 'm', 'j', 'r', 'n', 'l', '\0'};
+// Changed if the file format or FlatMessage arena layout changes.
+const uint32_t kVersion = 2;
+
+enum RecordState {
+  kRecordPending = 1,
+  kRecordDone = 2,
+};
+
+// Records are 8 byte aligned.
+size_t RoundUp(size_t size) { return (size + 7) & ~static_cast<size_t>(7); }
+
+}  // namespace
+
+// Start of each segment, followed by records.
+struct MessageJournal::SegmentHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t segment_size;
+  // Increases each time a segment becomes active, so segments can be
+  // replayed in order.
+  uint64_t generation;
+};
+
+// Start of each record, followed by a FlatMessage arena of size bytes.  The
+// end of a segment's records is marked by a record with size 0.
+struct MessageJournal::RecordHeader {
+  uint32_t size;
+  uint32_t state;
+};
+
+const MessageJournal::Ticket MessageJournal::kNoTicket;
+
+MessageJournal::MessageJournal(const std::string& path, const Options& options)
+    : segment_size_(RoundUp(options.segment_size)),
+      max_append_wait_(options.max_append_wait_ms),
+      storage_(nullptr),
+      mapped_(false),
+      active_(0),
+      end_(0),
+      next_generation_(1),
+      shutdown_(false),
+      appended_(0),
+      done_(0),
+      waits_(0),
+      unjournaled_(0),
+      recovered_(0),
+      recycled_(0) {
+  const size_t size = 2 * segment_size_;
+#if !defined(_WIN32)
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd >= 0) {
+    struct stat status;
+    // If the file was written with a different segment size it's resized,
+    // which invalidates the segment headers so it's treated as empty.
+    if (fstat(fd, &status) == 0 &&
+        (static_cast<size_t>(status.st_size) == size ||
+         ftruncate(fd, size) == 0)) {
+      void* mapping =
+          mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (mapping != MAP_FAILED) {
+        storage_ = static_cast<char*>(mapping);
+        mapped_ = true;
+      }
+    }
+    close(fd);
+  }
+#endif  // !defined(_WIN32)
+  if (!mapped_) {
+    LogMessage("MessageJournal: failed to map %s, journal is not persistent",
+               path.c_str());
+    storage_ = new char[size]();
+  }
+  pending_[0] = 0;
+  pending_[1] = 0;
+  Recover();
+  compaction_thread_ = std::thread(&MessageJournal::Compact, this);
+}
+
+MessageJournal::~MessageJournal() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  retired_.notify_one();
+  available_signal_.notify_all();
+  compaction_thread_.join();
+#if !defined(_WIN32)
+  if (mapped_) {
+    munmap(storage_, 2 * segment_size_);
+    return;
+  }
+#endif  // !defined(_WIN32)
+  delete[] storage_;
+}
+
+std::vector<MessageJournal::Unfinished> MessageJournal::TakeUnfinished() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Unfinished> unfinished;
+  unfinished.swap(unfinished_);
+  return unfinished;
+}
+
+MessageJournal::Ticket MessageJournal::Append(const FlatMessage& message) {
+  const size_t size = message.arena_size();
+  const size_t record_size = sizeof(RecordHeader) + RoundUp(size);
+  // Leave room for the end marker.
+  const size_t limit = segment_size_ - sizeof(RecordHeader);
+  if (!size || sizeof(SegmentHeader) + record_size > limit) {
+    LogMessage("MessageJournal: %d byte message is larger than a segment, "
+               "not journaled",
+               static_cast<int>(size));
+    unjournaled_++;
+    return kNoTicket;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (end_ + record_size > limit) {
+    // Wait for the compaction thread to recycle the other segment, unless
+    // another append has already switched segments.
+    auto ready = [this, record_size, limit]() {
+      return shutdown_ || end_ + record_size <= limit ||
+             available_[active_ ^ 1];
+    };
+    if (!ready()) {
+      waits_++;
+      available_signal_.wait_for(lock, max_append_wait_, ready);
+    }
+    if (end_ + record_size > limit) {
+      const int other = active_ ^ 1;
+      if (shutdown_ || !available_[other]) {
+        lock.unlock();
+        LogMessage("MessageJournal: no segment was recycled within %dms, "
+                   "message not journaled",
+                   static_cast<int>(max_append_wait_.count()));
+        unjournaled_++;
+        return kNoTicket;
+      }
+      // Retire the full segment, the compaction thread recycles it once all
+      // of its messages are done.
+      available_[active_] = false;
+      Activate(other);
+      retired_.notify_one();
+    }
+  }
+  const size_t offset = static_cast<size_t>(active_) * segment_size_ + end_;
+  char* record = storage_ + offset;
+  memcpy(record + sizeof(RecordHeader), message.arena(), size);
+  RecordHeader* header = reinterpret_cast<RecordHeader*>(record);
+  header->state = kRecordPending;
+  // Set the size last, so if the app is killed part way through appending
+  // the record is treated as the end of the segment.
+  std::atomic_signal_fence(std::memory_order_release);
+  header->size = static_cast<uint32_t>(size);
+  end_ += record_size;
+  pending_[active_]++;
+  appended_++;
+  return offset + 1;
+}
+
+void MessageJournal::Done(Ticket ticket) {
+  if (ticket == kNoTicket) return;
+  const size_t offset = static_cast<size_t>(ticket - 1);
+  const int index = static_cast<int>(offset / segment_size_);
+  reinterpret_cast<RecordHeader*>(storage_ + offset)->state = kRecordDone;
+  done_++;
+  if (--pending_[index] == 0) {
+    // Hold the lock so the compaction thread can't miss the notification.
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.notify_one();
+  }
+}
+
+MessageJournal::Metrics MessageJournal::GetMetrics() const {
+  Metrics metrics;
+  metrics.appended = appended_.load();
+  metrics.done = done_.load();
+  metrics.waits = waits_.load();
+  metrics.unjournaled = unjournaled_.load();
+  metrics.recovered = recovered_;
+  metrics.recycled = recycled_.load();
+  metrics.persistent = mapped_;
+  return metrics;
+}
+
+void MessageJournal::LogMetrics() const {
+  Metrics metrics = GetMetrics();
+  LogMessage(
+      "MessageJournal: appended=%d done=%d waits=%d unjournaled=%d "
+      "recovered=%d recycled=%d%s",
+      static_cast<int>(metrics.appended), static_cast<int>(metrics.done),
+      static_cast<int>(metrics.waits),
+      static_cast<int>(metrics.unjournaled),
+      static_cast<int>(metrics.recovered), static_cast<int>(metrics.recycled),
+      metrics.persistent ? " persistent" : "");
+}
+
+char* MessageJournal::segment(int index) const {
+  return storage_ + static_cast<size_t>(index) * segment_size_;
+}
+
+void MessageJournal::ResetSegment(int index) {
+  char* start = segment(index);
+  memset(start, 0, segment_size_);
+  SegmentHeader* header = reinterpret_cast<SegmentHeader*>(start);
+  memcpy(header->magic, kMagic, sizeof(kMagic));
+  header->version = kVersion;
+  header->segment_size = static_cast<uint32_t>(segment_size_);
+}
+
+void MessageJournal::Activate(int index) {
+  reinterpret_cast<SegmentHeader*>(segment(index))->generation =
+      next_generation_++;
+  active_ = index;
+  end_ = sizeof(SegmentHeader);
+}
+
+size_t MessageJournal::RecoverSegment(int index) {
+  const char* start = segment(index);
+  size_t offset = sizeof(SegmentHeader);
+  while (offset + sizeof(RecordHeader) <= segment_size_) {
+    const RecordHeader* record =
+        reinterpret_cast<const RecordHeader*>(start + offset);
+    const size_t record_size = sizeof(RecordHeader) + RoundUp(record->size);
+    if (record->size == 0 || offset + record_size > segment_size_) break;
+    Unfinished unfinished;
+    if (record->state == kRecordPending &&
+        FlatMessage::FromArena(start + offset + sizeof(RecordHeader),
+                               record->size, &unfinished.message)) {
+      // The record stays where it is, so its ticket is its offset.
+      unfinished.ticket =
+          static_cast<size_t>(index) * segment_size_ + offset + 1;
+      unfinished_.push_back(std::move(unfinished));
+      pending_[index]++;
+    }
+    offset += record_size;
+  }
+  return offset;
+}
+
+void MessageJournal::Recover() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool valid[2];
+  for (int i = 0; i < 2; ++i) {
+    const SegmentHeader* header =
+        reinterpret_cast<const SegmentHeader*>(segment(i));
+    valid[i] = memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+               header->version == kVersion &&
+               header->segment_size == segment_size_;
+    if (valid[i] && header->generation >= next_generation_) {
+      next_generation_ = header->generation + 1;
+    }
+  }
+  // Read pending records oldest segment first.
+  int newest = valid[1] ? 1 : 0;
+  if (valid[0] && valid[1] &&
+      reinterpret_cast<const SegmentHeader*>(segment(0))->generation >
+          reinterpret_cast<const SegmentHeader*>(segment(1))->generation) {
+    newest = 0;
+  }
+  const int oldest = newest ^ 1;
+  if (valid[oldest]) RecoverSegment(oldest);
+  if (valid[oldest] && pending_[oldest] != 0) {
+    // Recycled by the compaction thread once its messages are done.
+    available_[oldest] = false;
+  } else {
+    ResetSegment(oldest);
+    available_[oldest] = true;
+  }
+  available_[newest] = true;
+  if (valid[newest]) {
+    // Continue appending after the newest segment's records.  Anything after
+    // them is a partly written record, which is cleared so it can't be
+    // mistaken for a record later.
+    const size_t end = RecoverSegment(newest);
+    memset(segment(newest) + end, 0, segment_size_ - end);
+    active_ = newest;
+    end_ = end;
+  } else {
+    ResetSegment(newest);
+    Activate(newest);
+  }
+  recovered_ = unfinished_.size();
+}
+
+void MessageJournal::Compact() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!shutdown_) {
+    for (int i = 0; i < 2; ++i) {
+      if (available_[i] || pending_[i] != 0) continue;
+      // Nothing else touches a retired segment, so it can be cleared without
+      // holding the lock.
+      lock.unlock();
+      ResetSegment(i);
+      recycled_++;
+      lock.lock();
+      available_[i] = true;
+      available_signal_.notify_all();
+    }
+    retired_.wait(lock);
+  }
+}
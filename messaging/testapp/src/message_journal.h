@@ -0,0 +1,158 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_MESSAGE_JOURNAL_H_  // NOLINT
+#define FIREBASE_TESTAPP_MESSAGE_JOURNAL_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "flat_message.h"  // NOLINT
+
+// Records received messages in a memory mapped file until the app has
+// finished handling them, so messages aren't lost if the app is killed while
+// they're queued or being handled.  Messages that weren't finished are read
+// back when the journal is next opened, so the app can handle them again.
+//
+// The journal is split into two segments.  Messages are appended to the
+// active segment as FlatMessage arenas, which are copied without any further
+// encoding, and marked done in place.  When the active segment is full the
+// other segment becomes active, and a background thread recycles the full
+// segment once every message in it is done.  If neither segment has space,
+// Append() waits for a segment to be recycled, which slows the app to the
+// rate it handles messages rather than dropping them from the journal.
+//
+// Recovered messages are left where they are in the file.  Appending
+// continues after the records in the newest segment, and the older segment
+// is recycled once its recovered messages are done, so nothing is cleared
+// until it's been handled.  Every field of a message is journaled, so a
+// replayed message is the same as the original.
+//
+// Writes to the mapping survive the process being killed, but not the device
+// losing power.  On Windows, or if the file can't be mapped, the journal is
+// kept in memory and nothing is recovered.
+//
+// All methods are thread safe.
+class MessageJournal {
+ public:
+  // Identifies a journaled message, or kNoTicket if the message wasn't
+  // journaled.
+  typedef uint64_t Ticket;
+  static const Ticket kNoTicket = 0;
+
+  struct Options {
+    Options() : segment_size(1024 * 1024), max_append_wait_ms(1000) {}
+
+    // Size of each segment in bytes.
+    size_t segment_size;
+    // How long Append() waits for a segment to be recycled before giving up
+    // and not journaling the message, in case messages are never done.
+    int max_append_wait_ms;
+  };
+
+  struct Metrics {
+    uint64_t appended;
+    uint64_t done;
+    // Appends that waited for a segment to be recycled.
+    uint64_t waits;
+    // Messages that weren't journaled, because they're larger than a segment
+    // or no segment was recycled in time.
+    uint64_t unjournaled;
+    // Messages recovered when the journal was opened.
+    uint64_t recovered;
+    // Segments recycled after all of their messages were done.
+    uint64_t recycled;
+    bool persistent;
+  };
+
+  // A message recovered from the journal.
+  struct Unfinished {
+    FlatMessage message;
+    Ticket ticket;
+  };
+
+  // Open the journal in the file at path, recovering any messages that
+  // weren't done when it was last closed.
+  MessageJournal(const std::string& path, const Options& options);
+  // Stop the background thread and unmap the file.  Messages that weren't
+  // marked done are recovered next time the journal is opened.
+  ~MessageJournal();
+
+  // Messages that weren't done when the journal was last closed, oldest
+  // first.  They're still in the journal, so each should be marked done with
+  // its ticket once it's been handled again.
+  std::vector<Unfinished> TakeUnfinished();
+
+  // Record message before it's dispatched.  Blocks while the journal is
+  // full.
+  Ticket Append(const FlatMessage& message);
+  // Mark a message done once it's been handled or discarded.
+  void Done(Ticket ticket);
+
+  Metrics GetMetrics() const;
+  void LogMetrics() const;
+
+ private:
+  struct SegmentHeader;
+  struct RecordHeader;
+
+  char* segment(int index) const;
+  void ResetSegment(int index);
+  // Make segment index the active segment.  Must be called with mutex_ held.
+  void Activate(int index);
+  // Add the pending records of segment index to unfinished_, returning the
+  // offset of the end of its records.  Must be called with mutex_ held.
+  size_t RecoverSegment(int index);
+  void Recover();
+  void Compact();
+
+  const size_t segment_size_;
+  const std::chrono::milliseconds max_append_wait_;
+  char* storage_;
+  bool mapped_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable retired_;
+  // Signaled when a segment is recycled.
+  std::condition_variable available_signal_;
+  int active_;
+  // Offset of the end of the active segment's records.
+  size_t end_;
+  // Whether each segment is empty or active, rather than waiting to be
+  // recycled.
+  bool available_[2];
+  // Messages appended to each segment that aren't done.
+  std::atomic<uint64_t> pending_[2];
+  uint64_t next_generation_;
+  bool shutdown_;
+  std::thread compaction_thread_;
+
+  std::vector<Unfinished> unfinished_;
+  std::atomic<uint64_t> appended_;
+  std::atomic<uint64_t> done_;
+  std::atomic<uint64_t> waits_;
+  std::atomic<uint64_t> unjournaled_;
+  uint64_t recovered_;
+  std::atomic<uint64_t> recycled_;
+};
+
+#endif  // FIREBASE_TESTAPP_MESSAGE_JOURNAL_H_  // NOLINT
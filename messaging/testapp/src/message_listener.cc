@@ -0,0 +1,98 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_listener.h"  // NOLINT
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+#include "flat_message.h"  // NOLINT
+#include "latency_histogram.h"  // NOLINT
+
+MessageListener::MessageListener(const MessageWorkerPool::Handler& handler)
+    : handler_(handler),
+      worker_pool_(nullptr),
+      deduplicator_(nullptr),
+      journal_(nullptr),
+      token_store_(nullptr),
+      subscriptions_(nullptr),
+      start_time_ns_(LatencyHistogram::NowNanoseconds()) {}
+
+void MessageListener::OnMessage(
+    const ::firebase::messaging::Message& message) {
+  // When messages are received by the server, they are placed into an
+  // internal queue, waiting to be consumed. When ProcessMessages is called,
+  // this OnMessage function is called once for each queued message.
+  //
+  // Handing the message to a worker pool lets this return immediately so
+  // that a slow handler doesn't hold up delivery of later messages.
+  //
+  // The same message can be delivered more than once, e.g. after the app
+  // restarts, so messages that have already been seen are discarded.
+  if (deduplicator_ &&
+      deduplicator_->Contains(message.from, message.message_id)) {
+    LogMessage("Discarding duplicate message %s", message.message_id.c_str());
+    return;
+  }
+  // Journal the message before it's handled, so if the app is killed before
+  // it's been handled it can be handled when the app restarts.  Dispatch()
+  // only records it as seen once it's journaled, so a message redelivered
+  // after the app was killed before journaling it isn't discarded.
+  FlatMessage flat_message(message);
+  MessageJournal::Ticket ticket =
+      journal_ ? journal_->Append(flat_message) : MessageJournal::kNoTicket;
+  Dispatch(std::move(flat_message), ticket);
+}
+
+void MessageListener::Dispatch(FlatMessage&& message,
+                               MessageJournal::Ticket ticket) {
+  // A message the journal couldn't hold isn't durable, so it's left to be
+  // handled again if it's redelivered.
+  if (deduplicator_ && (!journal_ || ticket != MessageJournal::kNoTicket)) {
+    deduplicator_->Insert(message.from(), message.message_id());
+  }
+  if (worker_pool_) {
+    worker_pool_->Submit(std::move(message), ticket);
+  } else {
+    handler_(message);
+    if (journal_) journal_->Done(ticket);
+  }
+}
+
+void MessageListener::OnTokenReceived(const char* token) {
+  // To send a message to a specific instance of your app a registration token
+  // is required. These tokens are unique for each instance of the app. When
+  // messaging::Initialize is called, a request is sent to the Firebase Cloud
+  // Messaging server to generate a token. When that token is ready,
+  // OnTokenReceived will be called. The token should be cached locally so
+  // that a request doesn't need to be generated each time the app is started.
+  //
+  // Once a token is generated is should be sent to your app server, which can
+  // then use it to send messages to users.
+  LogMessage("Recieved Registration Token: %s (after %.1fms)", token,
+             static_cast<double>(LatencyHistogram::NowNanoseconds() -
+                                 start_time_ns_) /
+                 1e6);
+  if (token_store_ && !token_store_->Update(token)) {
+    LogMessage("Registration Token unchanged, not sending to app server");
+    return;
+  }
+  LogMessage("Send Registration Token to app server");
+  // Topic subscriptions belong to the old token, so they need to be made
+  // again.
+  if (subscriptions_) {
+    subscriptions_->ResetConfirmed();
+    subscriptions_->Update();
+  }
+}
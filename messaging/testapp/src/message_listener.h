@@ -0,0 +1,85 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_MESSAGE_LISTENER_H_  // NOLINT
+#define FIREBASE_TESTAPP_MESSAGE_LISTENER_H_  // NOLINT
+
+#include <stdint.h>
+
+#include "firebase/messaging.h"
+
+#include "flat_message.h"  // NOLINT
+#include "message_deduplicator.h"  // NOLINT
+#include "message_journal.h"  // NOLINT
+#include "message_worker_pool.h"  // NOLINT
+#include "token_store.h"  // NOLINT
+#include "topic_subscription_manager.h"  // NOLINT
+
+// Receives messages and registration tokens from Firebase Cloud Messaging and
+// passes them through the app's message pipeline.
+//
+// Each stage of the pipeline is optional, so the desktop benchmarks can drive
+// the same listener the app uses with only the stages they measure.
+class MessageListener : public firebase::messaging::Listener {
+ public:
+  // handler is the app's handling of a received message.
+  explicit MessageListener(const MessageWorkerPool::Handler& handler);
+
+  // Process messages on pool, or inline in OnMessage if pool is null.
+  void set_worker_pool(MessageWorkerPool* pool) { worker_pool_ = pool; }
+
+  // Discard messages deduplicator has seen before, or handle all messages if
+  // null.
+  void set_deduplicator(MessageDeduplicator* deduplicator) {
+    deduplicator_ = deduplicator;
+  }
+
+  // Record messages in journal until they've been handled, or don't journal
+  // messages if null.  When a journal is used with a worker pool, the pool
+  // must mark messages done in the same journal.
+  void set_journal(MessageJournal* journal) { journal_ = journal; }
+
+  // Cache tokens in store, or always send them to the app server if null.
+  void set_token_store(TokenStore* store) { token_store_ = store; }
+
+  // Resubscribe to topics managed by subscriptions when the token changes.
+  void set_subscriptions(TopicSubscriptionManager* subscriptions) {
+    subscriptions_ = subscriptions;
+  }
+
+  // Time the app started, from LatencyHistogram::NowNanoseconds(), used to
+  // log how long the app waited for a registration token.
+  void set_start_time_ns(int64_t start_time_ns) {
+    start_time_ns_ = start_time_ns;
+  }
+
+  virtual void OnMessage(const ::firebase::messaging::Message& message);
+  // Pass a message that's already been received, e.g. one recovered from the
+  // journal, on to the app's handler, recording it in the deduplicator so
+  // it's discarded if it's delivered again.  ticket is the message's journal
+  // ticket.
+  void Dispatch(FlatMessage&& message, MessageJournal::Ticket ticket);
+  virtual void OnTokenReceived(const char* token);
+
+ private:
+  MessageWorkerPool::Handler handler_;
+  MessageWorkerPool* worker_pool_;
+  MessageDeduplicator* deduplicator_;
+  MessageJournal* journal_;
+  TokenStore* token_store_;
+  TopicSubscriptionManager* subscriptions_;
+  int64_t start_time_ns_;
+};
+
+#endif  // FIREBASE_TESTAPP_MESSAGE_LISTENER_H_  // NOLINT
@@ -0,0 +1,206 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_router.h"  // NOLINT
+
+#include <algorithm>
+
+MessageRouter::MessageRouter() : next_id_(1), root_(new Node()) {}
+
+MessageRouter::SubscriptionId MessageRouter::Subscribe(
+    const std::string& pattern, const Subscriber& subscriber) {
+  Subscription subscription;
+  subscription.subscriber = subscriber;
+  return Add(pattern, std::move(subscription));
+}
+
+MessageRouter::SubscriptionId MessageRouter::Subscribe(
+    const std::string& pattern, const std::string& key,
+    const std::string& value, const Subscriber& subscriber) {
+  Subscription subscription;
+  subscription.key = key;
+  subscription.value = value;
+  subscription.subscriber = subscriber;
+  return Add(pattern, std::move(subscription));
+}
+
+MessageRouter::SubscriptionId MessageRouter::Add(const std::string& pattern,
+                                                 Subscription&& subscription) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const SubscriptionId id = next_id_++;
+  subscription.id = id;
+  std::atomic_store(&root_, Update(std::atomic_load(&root_).get(), pattern, 0,
+                                   &subscription, id));
+  patterns_[id] = pattern;
+  return id;
+}
+
+void MessageRouter::Unsubscribe(SubscriptionId id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<SubscriptionId, std::string>::iterator it = patterns_.find(id);
+  if (it == patterns_.end()) return;
+  NodePtr root = Update(std::atomic_load(&root_).get(), it->second, 0,
+                        nullptr, id);
+  std::atomic_store(&root_, root ? root : NodePtr(new Node()));
+  patterns_.erase(it);
+}
+
+MessageRouter::NodePtr MessageRouter::Update(const Node* node,
+                                             const std::string& pattern,
+                                             size_t index,
+                                             Subscription* subscription,
+                                             SubscriptionId id) {
+  std::shared_ptr<Node> copy(node ? new Node(*node) : new Node());
+  const bool prefix = !pattern.empty() && pattern[pattern.size() - 1] == '*';
+  const size_t length = prefix ? pattern.size() - 1 : pattern.size();
+  if (index == length) {
+    SubscriptionsPtr& subscriptions = prefix ? copy->prefix : copy->exact;
+    std::shared_ptr<Subscriptions> changed(
+        subscriptions ? new Subscriptions(*subscriptions)
+                      : new Subscriptions());
+    if (subscription) {
+      Insert(changed.get(), std::move(*subscription));
+    } else {
+      Remove(changed.get(), id);
+    }
+    if (changed->all.empty() && changed->filtered.empty()) {
+      subscriptions.reset();
+    } else {
+      subscriptions = changed;
+    }
+  } else {
+    std::vector<std::pair<char, NodePtr>>& children = copy->children;
+    std::vector<std::pair<char, NodePtr>>::iterator it = children.begin();
+    while (it != children.end() && it->first < pattern[index]) ++it;
+    const bool found = it != children.end() && it->first == pattern[index];
+    NodePtr child = Update(found ? it->second.get() : nullptr, pattern,
+                           index + 1, subscription, id);
+    if (found) {
+      if (child) {
+        it->second = child;
+      } else {
+        children.erase(it);
+      }
+    } else if (child) {
+      children.insert(it, std::make_pair(pattern[index], child));
+    }
+  }
+  // Drop nodes left empty by removing a subscription.
+  if (copy->children.empty() && !copy->prefix && !copy->exact) {
+    return NodePtr();
+  }
+  return copy;
+}
+
+void MessageRouter::Insert(Subscriptions* subscriptions,
+                           Subscription&& subscription) {
+  SubscriptionPtr added(new Subscription(std::move(subscription)));
+  if (added->key.empty()) {
+    subscriptions->all.push_back(std::move(added));
+    return;
+  }
+  std::vector<std::string>& keys = subscriptions->keys;
+  if (std::find(keys.begin(), keys.end(), added->key) == keys.end()) {
+    keys.push_back(added->key);
+  }
+  std::vector<SubscriptionPtr>& filtered = subscriptions->filtered;
+  std::vector<SubscriptionPtr>::iterator it = std::upper_bound(
+      filtered.begin(), filtered.end(), added,
+      [](const SubscriptionPtr& a, const SubscriptionPtr& b) {
+        return a->key < b->key || (a->key == b->key && a->value < b->value);
+      });
+  filtered.insert(it, std::move(added));
+}
+
+void MessageRouter::Remove(Subscriptions* subscriptions, SubscriptionId id) {
+  auto matches = [id](const SubscriptionPtr& s) { return s->id == id; };
+  std::vector<SubscriptionPtr>::iterator it = std::find_if(
+      subscriptions->all.begin(), subscriptions->all.end(), matches);
+  if (it != subscriptions->all.end()) {
+    subscriptions->all.erase(it);
+    return;
+  }
+  std::vector<SubscriptionPtr>& filtered = subscriptions->filtered;
+  it = std::find_if(filtered.begin(), filtered.end(), matches);
+  if (it == filtered.end()) return;
+  const std::string key = (*it)->key;
+  filtered.erase(it);
+  for (it = filtered.begin(); it != filtered.end(); ++it) {
+    if ((*it)->key == key) return;
+  }
+  std::vector<std::string>& keys = subscriptions->keys;
+  keys.erase(std::find(keys.begin(), keys.end(), key));
+}
+
+size_t MessageRouter::Dispatch(const FlatMessage& message) const {
+  // Hold a reference to the root so the trie isn't freed by a concurrent
+  // change while it's being read.
+  NodePtr root = std::atomic_load(&root_);
+  const StringView from = message.from();
+  size_t called = 0;
+  const Node* node = root.get();
+  for (size_t i = 0;; ++i) {
+    called += Call(node->prefix.get(), message);
+    if (i == from.size) {
+      called += Call(node->exact.get(), message);
+      break;
+    }
+    std::vector<std::pair<char, NodePtr>>::const_iterator it =
+        std::lower_bound(node->children.begin(), node->children.end(),
+                         from.data[i],
+                         [](const std::pair<char, NodePtr>& child, char c) {
+                           return child.first < c;
+                         });
+    if (it == node->children.end() || it->first != from.data[i]) break;
+    node = it->second.get();
+  }
+  return called;
+}
+
+size_t MessageRouter::Call(const Subscriptions* subscriptions,
+                           const FlatMessage& message) {
+  if (!subscriptions) return 0;
+  size_t called = 0;
+  for (size_t i = 0; i < subscriptions->all.size(); ++i) {
+    subscriptions->all[i]->subscriber(message);
+    called++;
+  }
+  // Look up each key the subscriptions filter on, then find the
+  // subscriptions for the message's value.
+  const std::vector<SubscriptionPtr>& filtered = subscriptions->filtered;
+  for (size_t k = 0; k < subscriptions->keys.size(); ++k) {
+    const StringView key(subscriptions->keys[k]);
+    StringView value;
+    if (!message.Find(key, &value)) continue;
+    std::vector<SubscriptionPtr>::const_iterator it = std::lower_bound(
+        filtered.begin(), filtered.end(), value,
+        [&key](const SubscriptionPtr& subscription, const StringView& target) {
+          int compare = StringView(subscription->key).Compare(key);
+          return compare < 0 ||
+                 (compare == 0 && StringView(subscription->value) < target);
+        });
+    for (; it != filtered.end() && StringView((*it)->key) == key &&
+           StringView((*it)->value) == value;
+         ++it) {
+      (*it)->subscriber(message);
+      called++;
+    }
+  }
+  return called;
+}
+
+size_t MessageRouter::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return patterns_.size();
+}
@@ -0,0 +1,130 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_MESSAGE_ROUTER_H_  // NOLINT
+#define FIREBASE_TESTAPP_MESSAGE_ROUTER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flat_message.h"  // NOLINT
+
+// Fans received messages out to any number of subscribers within the app,
+// each interested in messages from particular senders or topics.
+//
+// Subscriptions are matched against a message's from field, e.g.
+// "/topics/news", using a trie, so the cost of routing a message depends on
+// the length of its from field and the number of matching subscribers rather
+// than the total number of subscribers.  A subscription can also require a
+// data entry to have a particular value.  Subscribers are passed the message
+// by reference, so it's never copied.
+//
+// Subscribers are called on the thread that calls Dispatch(), in no
+// particular order.  Subscribe() and Unsubscribe() can be called at any time,
+// and only affect subsequent calls to Dispatch().
+class MessageRouter {
+ public:
+  typedef std::function<void(const FlatMessage& message)> Subscriber;
+  typedef uint32_t SubscriptionId;
+
+  MessageRouter();
+
+  // Call subscriber for messages whose from field matches pattern.  A pattern
+  // ending in '*' matches any from field starting with the rest of the
+  // pattern, e.g. "/topics/*" matches all topic messages and "*" all
+  // messages, otherwise from must match the pattern exactly.
+  SubscriptionId Subscribe(const std::string& pattern,
+                           const Subscriber& subscriber);
+  // As above, limited to messages with the data entry key set to value.
+  SubscriptionId Subscribe(const std::string& pattern, const std::string& key,
+                           const std::string& value,
+                           const Subscriber& subscriber);
+  void Unsubscribe(SubscriptionId id);
+
+  // Pass message to every matching subscriber, returning the number called.
+  size_t Dispatch(const FlatMessage& message) const;
+
+  // Number of subscriptions.
+  size_t size() const;
+
+ private:
+  struct Subscription {
+    SubscriptionId id;
+    // Data entry required to match, unless key is empty.
+    std::string key;
+    std::string value;
+    Subscriber subscriber;
+  };
+
+  typedef std::shared_ptr<const Subscription> SubscriptionPtr;
+
+  // Subscriptions for a pattern.
+  struct Subscriptions {
+    // Subscriptions without a data entry.
+    std::vector<SubscriptionPtr> all;
+    // Subscriptions with a data entry, sorted by key and value.
+    std::vector<SubscriptionPtr> filtered;
+    // Distinct keys in filtered.
+    std::vector<std::string> keys;
+  };
+  typedef std::shared_ptr<const Subscriptions> SubscriptionsPtr;
+
+  struct Node;
+  typedef std::shared_ptr<const Node> NodePtr;
+
+  // Nodes are immutable once they're in the trie.  A change copies the nodes
+  // on the path to the pattern it changes, sharing the rest of the trie, so
+  // Dispatch() reads the trie without locking.  The copies share the
+  // subscriptions of every node but the one that changes, and that node's
+  // subscriptions are copied as pointers, so a change costs the same however
+  // many subscribers there are.
+  struct Node {
+    // Child node for each following character, sorted by character.
+    std::vector<std::pair<char, NodePtr>> children;
+    // Patterns ending with '*' at this node, or null if there are none.
+    SubscriptionsPtr prefix;
+    // Patterns ending at this node, or null if there are none.
+    SubscriptionsPtr exact;
+  };
+
+  // Return a copy of node with subscription added to, or the subscription
+  // with id removed from, the node for pattern[index:].  node may be null.
+  static NodePtr Update(const Node* node, const std::string& pattern,
+                        size_t index, Subscription* subscription,
+                        SubscriptionId id);
+  static void Insert(Subscriptions* subscriptions, Subscription&& subscription);
+  static void Remove(Subscriptions* subscriptions, SubscriptionId id);
+  SubscriptionId Add(const std::string& pattern, Subscription&& subscription);
+  // subscriptions may be null.
+  static size_t Call(const Subscriptions* subscriptions,
+                     const FlatMessage& message);
+
+  // Serializes changes.
+  mutable std::mutex mutex_;
+  SubscriptionId next_id_;
+  // Pattern of each subscription.
+  std::map<SubscriptionId, std::string> patterns_;
+  // Accessed with std::atomic_load() and std::atomic_store().
+  NodePtr root_;
+};
+
+#endif  // FIREBASE_TESTAPP_MESSAGE_ROUTER_H_  // NOLINT
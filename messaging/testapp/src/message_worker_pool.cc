@@ -0,0 +1,167 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_worker_pool.h"  // NOLINT
+
+#include <string>
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+namespace {
+
+// Returns the value of data_key in message, or its collapse_key if data_key
+// is empty or not present.
+std::string CoalesceKey(const FlatMessage& message,
+                        const std::string& data_key) {
+  StringView value;
+  if (!data_key.empty() && message.Find(data_key, &value)) {
+    return value.ToString();
+  }
+  return message.collapse_key().ToString();
+}
+
+bool IsHighPriority(const FlatMessage& message) {
+  return message.priority() == StringView("high");
+}
+
+}  // namespace
+
+MessageWorkerPool::MessageWorkerPool(const Options& options,
+                                     const Handler& handler)
+    : handler_(handler),
+      journal_(options.journal),
+      priority_lane_(options.num_priority_workers > 0),
+      queue_(options.queue_capacity, options.overflow,
+             [options](const Item& item) {
+               return CoalesceKey(item.message, options.coalesce_data_key);
+             }),
+      priority_queue_(options.queue_capacity, kOverflowBlock),
+      submitted_(0),
+      processed_(0),
+      dropped_(0),
+      coalesced_(0),
+      prioritized_(0),
+      max_queue_depth_(0) {
+  size_t num_workers = options.num_workers ? options.num_workers : 1;
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers_.push_back(
+        std::thread(&MessageWorkerPool::Run, this, &queue_, &latency_));
+  }
+  for (size_t i = 0; i < options.num_priority_workers; ++i) {
+    workers_.push_back(std::thread(&MessageWorkerPool::Run, this,
+                                   &priority_queue_, &priority_latency_));
+  }
+}
+
+MessageWorkerPool::~MessageWorkerPool() {
+  queue_.Close();
+  priority_queue_.Close();
+  for (size_t i = 0; i < workers_.size(); ++i) workers_[i].join();
+}
+
+void MessageWorkerPool::Submit(const ::firebase::messaging::Message& message) {
+  Item item;
+  item.submit_time_ns = LatencyHistogram::NowNanoseconds();
+  item.message = FlatMessage(message);
+  item.ticket = MessageJournal::kNoTicket;
+  Enqueue(std::move(item));
+}
+
+void MessageWorkerPool::Submit(FlatMessage&& message,
+                               MessageJournal::Ticket ticket) {
+  Item item;
+  item.message = std::move(message);
+  item.submit_time_ns = LatencyHistogram::NowNanoseconds();
+  item.ticket = ticket;
+  Enqueue(std::move(item));
+}
+
+void MessageWorkerPool::Enqueue(Item&& item) {
+  submitted_++;
+  const MessageJournal::Ticket ticket = item.ticket;
+  Item displaced;
+  displaced.ticket = MessageJournal::kNoTicket;
+  if (priority_lane_ && IsHighPriority(item.message)) {
+    prioritized_++;
+    if (priority_queue_.Push(std::move(item)) == kPushClosed) {
+      dropped_++;
+      if (journal_) journal_->Done(ticket);
+    }
+    return;
+  }
+  switch (queue_.Push(std::move(item), &displaced)) {
+    case kPushQueued:
+      break;
+    case kPushDroppedOldest:
+      dropped_++;
+      break;
+    case kPushCoalesced:
+      coalesced_++;
+      break;
+    case kPushClosed:
+      dropped_++;
+      displaced.ticket = ticket;
+      break;
+  }
+  // A message that won't be handled is finished with.
+  if (journal_) journal_->Done(displaced.ticket);
+  size_t depth = queue_.size();
+  size_t max_depth = max_queue_depth_.load();
+  while (depth > max_depth &&
+         !max_queue_depth_.compare_exchange_weak(max_depth, depth)) {
+  }
+}
+
+void MessageWorkerPool::Run(BoundedQueue<Item>* queue,
+                            LatencyHistogram* latency) {
+  Item item;
+  while (queue->Pop(&item)) {
+    handler_(item.message);
+    if (journal_) journal_->Done(item.ticket);
+    latency->Record(LatencyHistogram::NowNanoseconds() - item.submit_time_ns);
+    processed_++;
+  }
+}
+
+MessageWorkerPool::Metrics MessageWorkerPool::GetMetrics() const {
+  Metrics metrics;
+  metrics.submitted = submitted_.load();
+  metrics.processed = processed_.load();
+  metrics.dropped = dropped_.load();
+  metrics.coalesced = coalesced_.load();
+  metrics.prioritized = prioritized_.load();
+  metrics.queue_depth = queue_.size();
+  metrics.max_queue_depth = max_queue_depth_.load();
+  metrics.latency_p50_ns = latency_.Percentile(50);
+  metrics.latency_p99_ns = latency_.Percentile(99);
+  metrics.priority_latency_p99_ns = priority_latency_.Percentile(99);
+  return metrics;
+}
+
+void MessageWorkerPool::LogMetrics() const {
+  Metrics metrics = GetMetrics();
+  LogMessage(
+      "MessageWorkerPool: submitted=%d processed=%d dropped=%d coalesced=%d "
+      "prioritized=%d queue_depth=%d max_queue_depth=%d latency_p50=%lldns "
+      "latency_p99=%lldns priority_latency_p99=%lldns",
+      static_cast<int>(metrics.submitted), static_cast<int>(metrics.processed),
+      static_cast<int>(metrics.dropped), static_cast<int>(metrics.coalesced),
+      static_cast<int>(metrics.prioritized),
+      static_cast<int>(metrics.queue_depth),
+      static_cast<int>(metrics.max_queue_depth),
+      static_cast<long long>(metrics.latency_p50_ns),  // NOLINT
+      static_cast<long long>(metrics.latency_p99_ns),  // NOLINT
+      static_cast<long long>(metrics.priority_latency_p99_ns));  // NOLINT
+}
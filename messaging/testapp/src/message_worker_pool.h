@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_MESSAGE_WORKER_POOL_H_  // NOLINT
+#define FIREBASE_TESTAPP_MESSAGE_WORKER_POOL_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "firebase/messaging.h"
+
+#include "bounded_queue.h"  // NOLINT
+#include "flat_message.h"  // NOLINT
+#include "latency_histogram.h"  // NOLINT
+#include "message_journal.h"  // NOLINT
+
+// Processes messages on a pool of worker threads so that
+// Listener::OnMessage() can return as soon as the message is queued, rather
+// than blocking message delivery while the app handles it.
+//
+// Messages are queued and handled as FlatMessage so that each queued message
+// is a single allocation.
+//
+// High priority messages skip the queue: they're handled by dedicated workers
+// so they aren't held up behind a burst of normal priority messages, and are
+// never coalesced or dropped.
+class MessageWorkerPool {
+ public:
+  typedef std::function<void(const FlatMessage& message)> Handler;
+
+  struct Options {
+    Options()
+        : num_workers(2),
+          num_priority_workers(1),
+          queue_capacity(256),
+          overflow(kOverflowBlock),
+          journal(nullptr) {}
+
+    size_t num_workers;
+    // Workers dedicated to messages with "high" priority.  If 0, high
+    // priority messages are queued with all other messages.
+    size_t num_priority_workers;
+    // Maximum number of messages waiting to be processed in each lane.
+    size_t queue_capacity;
+    // What to do when a message arrives and the queue is full.  When
+    // coalescing, a queued message is replaced by a newer message with the
+    // same coalescing key.
+    OverflowPolicy overflow;
+    // Data entry used as the coalescing key, e.g. a "type" field where only
+    // the latest message of each type matters.  Messages without this entry,
+    // or all messages if it's empty, are coalesced by collapse_key.
+    std::string coalesce_data_key;
+    // If set, messages submitted with a journal ticket are marked done once
+    // they've been handled, coalesced or dropped.
+    MessageJournal* journal;
+  };
+
+  struct Metrics {
+    uint64_t submitted;
+    uint64_t processed;
+    // Messages discarded to make room in a full queue.
+    uint64_t dropped;
+    // Messages replaced by a newer message with the same coalescing key.
+    uint64_t coalesced;
+    // Messages handled in the high priority lane.
+    uint64_t prioritized;
+    size_t queue_depth;
+    size_t max_queue_depth;
+    // Time from Submit() to the handler returning, in nanoseconds.
+    int64_t latency_p50_ns;
+    int64_t latency_p99_ns;
+    // As above, for the high priority lane.
+    int64_t priority_latency_p99_ns;
+  };
+
+  // Start num_workers threads which call handler for each message.
+  MessageWorkerPool(const Options& options, const Handler& handler);
+  // Process all queued messages then stop the worker threads.
+  ~MessageWorkerPool();
+
+  // Queue a message to be processed.  Depending upon the overflow policy
+  // this may block until there is space in the queue.
+  void Submit(const ::firebase::messaging::Message& message);
+  void Submit(FlatMessage&& message,
+              MessageJournal::Ticket ticket = MessageJournal::kNoTicket);
+
+  Metrics GetMetrics() const;
+  void LogMetrics() const;
+
+ private:
+  struct Item {
+    FlatMessage message;
+    int64_t submit_time_ns;
+    MessageJournal::Ticket ticket;
+  };
+
+  void Enqueue(Item&& item);
+  void Run(BoundedQueue<Item>* queue, LatencyHistogram* latency);
+
+  Handler handler_;
+  MessageJournal* journal_;
+  const bool priority_lane_;
+  BoundedQueue<Item> queue_;
+  BoundedQueue<Item> priority_queue_;
+  std::vector<std::thread> workers_;
+
+  std::atomic<uint64_t> submitted_;
+  std::atomic<uint64_t> processed_;
+  std::atomic<uint64_t> dropped_;
+  std::atomic<uint64_t> coalesced_;
+  std::atomic<uint64_t> prioritized_;
+  std::atomic<size_t> max_queue_depth_;
+  LatencyHistogram latency_;
+  LatencyHistogram priority_latency_;
+};
+
+#endif  // FIREBASE_TESTAPP_MESSAGE_WORKER_POOL_H_  // NOLINT
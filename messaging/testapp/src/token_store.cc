@@ -0,0 +1,102 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "token_store.h"  // NOLINT
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+#include "file_util.h"  // NOLINT
+
+namespace {
+
+// First line of the file, changed if the format changes.
+const char kFileHeader[] = "fcm_token_store 1";
+
+}  // namespace
+
+TokenStore::TokenStore(const std::string& path,
+                       const std::string& app_instance_key)
+    : path_(path), app_instance_key_(app_instance_key), timestamp_ms_(0) {}
+
+bool TokenStore::Load() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  token_.clear();
+  timestamp_ms_ = 0;
+  FILE* file = fopen(path_.c_str(), "r");
+  if (!file) return false;
+  std::string header, key, timestamp, token;
+  bool read = ReadLine(file, &header) && ReadLine(file, &key) &&
+              ReadLine(file, &timestamp) && ReadLine(file, &token);
+  fclose(file);
+  if (!read || header != kFileHeader || key != app_instance_key_ ||
+      token.empty()) {
+    return false;
+  }
+  token_ = token;
+  timestamp_ms_ = strtoll(timestamp.c_str(), nullptr, 10);
+  return true;
+}
+
+bool TokenStore::Update(const char* token) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (token_ == token) return false;
+  token_ = token;
+  timestamp_ms_ = WallClockMilliseconds();
+  if (!Save()) LogMessage("TokenStore: failed to write %s", path_.c_str());
+  return true;
+}
+
+void TokenStore::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  token_.clear();
+  timestamp_ms_ = 0;
+  remove(path_.c_str());
+}
+
+std::string TokenStore::token() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return token_;
+}
+
+int64_t TokenStore::timestamp_ms() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return timestamp_ms_;
+}
+
+// Write to a temporary file and rename it over the store, so the store is
+// never left partially written.  Must be called with mutex_ held.
+bool TokenStore::Save() {
+  const std::string temporary_path = path_ + ".tmp";
+  FILE* file = fopen(temporary_path.c_str(), "w");
+  if (!file) return false;
+  bool written =
+      fprintf(file, "%s\n%s\n%lld\n%s\n", kFileHeader,
+              app_instance_key_.c_str(),
+              static_cast<long long>(timestamp_ms_),  // NOLINT
+              token_.c_str()) > 0;
+  written = fclose(file) == 0 && written;
+  if (!written) {
+    remove(temporary_path.c_str());
+    return false;
+  }
+#ifdef _WIN32
+  // rename() won't replace an existing file on Windows.
+  remove(path_.c_str());
+#endif  // _WIN32
+  return rename(temporary_path.c_str(), path_.c_str()) == 0;
+}
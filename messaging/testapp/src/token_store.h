@@ -0,0 +1,65 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_TOKEN_STORE_H_  // NOLINT
+#define FIREBASE_TESTAPP_TOKEN_STORE_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+
+// Caches the FCM registration token on disk so that it's available as soon as
+// the app starts, rather than when Listener::OnTokenReceived() is called.
+//
+// The token is stored with the time it was received and a key identifying
+// the app instance, so a token cached by a different app (e.g. a different
+// Firebase project) is never used.  A token only needs to be sent to the app
+// server when OnTokenReceived() delivers a value that differs from the cached
+// token.
+//
+// All methods are thread safe.
+class TokenStore {
+ public:
+  // Create a store which keeps the token in the file at path.
+  TokenStore(const std::string& path, const std::string& app_instance_key);
+
+  // Read the cached token.  Returns true if a token cached by this app
+  // instance was found.
+  bool Load();
+
+  // Record a token delivered by OnTokenReceived().  Returns true if it
+  // differs from the cached token, in which case it's saved and should be
+  // sent to the app server.
+  bool Update(const char* token);
+
+  // Discard the cached token, e.g. after the app server rejects it.
+  void Clear();
+
+  // The cached token, or an empty string if there isn't one.
+  std::string token() const;
+  // Milliseconds since the epoch when the cached token was received.
+  int64_t timestamp_ms() const;
+
+ private:
+  bool Save();
+
+  const std::string path_;
+  const std::string app_instance_key_;
+  mutable std::mutex mutex_;
+  std::string token_;
+  int64_t timestamp_ms_;
+};
+
+#endif  // FIREBASE_TESTAPP_TOKEN_STORE_H_  // NOLINT
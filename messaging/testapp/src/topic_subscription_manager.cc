@@ -0,0 +1,220 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "topic_subscription_manager.h"  // NOLINT
+
+#include <stdio.h>
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+#include "file_util.h"  // NOLINT
+
+namespace {
+
+// First line of the file, changed if the format changes.
+const char kFileHeader[] = "fcm_topic_subscriptions 1";
+
+}  // namespace
+
+TopicSubscriptionManager::TopicSubscriptionManager(
+    const std::string& path, const RequestFunction& request,
+    const Options& options)
+    : path_(path),
+      request_(request),
+      options_(options),
+      in_flight_(0),
+      updating_(false),
+      update_requested_(false) {
+  metrics_.requests = 0;
+  metrics_.failures = 0;
+  metrics_.abandoned = 0;
+  metrics_.skipped = 0;
+  Load();
+}
+
+void TopicSubscriptionManager::SetDesiredTopics(
+    const std::vector<std::string>& topics) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  desired_.clear();
+  for (size_t i = 0; i < topics.size(); ++i) {
+    if (!desired_.insert(topics[i]).second) continue;
+    if (confirmed_.count(topics[i])) metrics_.skipped++;
+  }
+}
+
+bool TopicSubscriptionManager::Update() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (updating_) {
+      // A request completed synchronously; let the outer call pick up any
+      // requests it made possible rather than recursing.
+      update_requested_ = true;
+      return desired_ == confirmed_;
+    }
+    updating_ = true;
+  }
+  std::vector<Request> requests;
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      update_requested_ = false;
+      requests.clear();
+      SelectRequests(SteadyClockMilliseconds(), &requests);
+      if (requests.empty()) {
+        updating_ = false;
+        return desired_ == confirmed_;
+      }
+    }
+    for (size_t i = 0; i < requests.size(); ++i) {
+      const Request& request = requests[i];
+      const std::string topic = request.topic;
+      const bool subscribe = request.subscribe;
+      request_(topic, subscribe, [this, topic, subscribe](bool success) {
+        OnComplete(topic, subscribe, success);
+      });
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!update_requested_) {
+      updating_ = false;
+      return desired_ == confirmed_;
+    }
+  }
+}
+
+void TopicSubscriptionManager::SelectRequests(int64_t now_ms,
+                                              std::vector<Request>* requests) {
+  // Topics to subscribe to are in desired_ but not confirmed_, topics to
+  // unsubscribe from the reverse.  Walk both sorted sets together.
+  std::set<std::string>::const_iterator desired = desired_.begin();
+  std::set<std::string>::const_iterator confirmed = confirmed_.begin();
+  while (in_flight_ < options_.max_in_flight &&
+         (desired != desired_.end() || confirmed != confirmed_.end())) {
+    Request request;
+    if (confirmed == confirmed_.end() ||
+        (desired != desired_.end() && *desired < *confirmed)) {
+      request.topic = *desired++;
+      request.subscribe = true;
+    } else if (desired == desired_.end() || *confirmed < *desired) {
+      request.topic = *confirmed++;
+      request.subscribe = false;
+    } else {
+      ++desired;
+      ++confirmed;
+      continue;
+    }
+    TopicState& state = states_[request.topic];
+    if (state.in_flight || state.attempts >= options_.max_attempts ||
+        state.next_attempt_ms > now_ms) {
+      continue;
+    }
+    state.in_flight = true;
+    in_flight_++;
+    metrics_.requests++;
+    requests->push_back(request);
+  }
+}
+
+void TopicSubscriptionManager::OnComplete(const std::string& topic,
+                                          bool subscribe, bool success) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_--;
+    if (success) {
+      if (subscribe) {
+        confirmed_.insert(topic);
+      } else {
+        confirmed_.erase(topic);
+      }
+      states_.erase(topic);
+      Save();
+    } else {
+      TopicState& state = states_[topic];
+      state.in_flight = false;
+      state.attempts++;
+      metrics_.failures++;
+      if (state.attempts >= options_.max_attempts) {
+        metrics_.abandoned++;
+        LogMessage("TopicSubscriptionManager: giving up on %s %s",
+                   subscribe ? "subscribing to" : "unsubscribing from",
+                   topic.c_str());
+      } else {
+        int64_t backoff_ms = options_.initial_backoff_ms;
+        for (int i = 1;
+             i < state.attempts && backoff_ms < options_.max_backoff_ms; ++i) {
+          backoff_ms *= 2;
+        }
+        if (backoff_ms > options_.max_backoff_ms) {
+          backoff_ms = options_.max_backoff_ms;
+        }
+        state.next_attempt_ms = SteadyClockMilliseconds() + backoff_ms;
+      }
+    }
+  }
+  // Fill the slot this request freed.
+  Update();
+}
+
+void TopicSubscriptionManager::ResetConfirmed() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  confirmed_.clear();
+  for (std::map<std::string, TopicState>::iterator it = states_.begin();
+       it != states_.end(); ++it) {
+    it->second.attempts = 0;
+    it->second.next_attempt_ms = 0;
+  }
+  Save();
+}
+
+TopicSubscriptionManager::Metrics TopicSubscriptionManager::GetMetrics()
+    const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return metrics_;
+}
+
+void TopicSubscriptionManager::Load() {
+  FILE* file = fopen(path_.c_str(), "r");
+  if (!file) return;
+  std::string line;
+  if (ReadLine(file, &line) && line == kFileHeader) {
+    while (ReadLine(file, &line)) {
+      if (!line.empty()) confirmed_.insert(line);
+    }
+  }
+  fclose(file);
+}
+
+// Write to a temporary file and rename it over the old one, so the file is
+// never left partially written.
+void TopicSubscriptionManager::Save() {
+  const std::string temporary_path = path_ + ".tmp";
+  FILE* file = fopen(temporary_path.c_str(), "w");
+  bool written = file && fprintf(file, "%s\n", kFileHeader) > 0;
+  for (std::set<std::string>::const_iterator it = confirmed_.begin();
+       written && it != confirmed_.end(); ++it) {
+    written = fprintf(file, "%s\n", it->c_str()) > 0;
+  }
+  if (file) written = fclose(file) == 0 && written;
+  if (written) {
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows.
+    remove(path_.c_str());
+#endif  // _WIN32
+    written = rename(temporary_path.c_str(), path_.c_str()) == 0;
+  }
+  if (!written) {
+    remove(temporary_path.c_str());
+    LogMessage("TopicSubscriptionManager: failed to write %s", path_.c_str());
+  }
+}
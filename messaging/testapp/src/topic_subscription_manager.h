@@ -0,0 +1,130 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_TOPIC_SUBSCRIPTION_MANAGER_H_  // NOLINT
+#define FIREBASE_TESTAPP_TOPIC_SUBSCRIPTION_MANAGER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Keeps the app's topic subscriptions in sync with the set of topics it
+// wants, without re-issuing requests on every launch.
+//
+// The set of topics confirmed as subscribed is persisted.  Update() compares
+// the desired set against it and only issues the Subscribe and Unsubscribe
+// requests needed to reconcile the two, with a bounded number in flight.
+// Failed requests are retried with exponential backoff.
+//
+// All methods are thread safe.
+class TopicSubscriptionManager {
+ public:
+  // Called with the result of a request.
+  typedef std::function<void(bool success)> CompletionCallback;
+  // Start subscribing to (or unsubscribing from) topic, calling complete when
+  // the request finishes.  complete may be called before this returns.
+  typedef std::function<void(const std::string& topic, bool subscribe,
+                             const CompletionCallback& complete)>
+      RequestFunction;
+
+  struct Options {
+    Options()
+        : max_in_flight(4),
+          initial_backoff_ms(1000),
+          max_backoff_ms(5 * 60 * 1000),
+          max_attempts(8) {}
+
+    // Maximum number of requests started but not yet complete.
+    size_t max_in_flight;
+    // Delay before the first retry of a failed request, doubled after each
+    // subsequent failure up to max_backoff_ms.
+    int64_t initial_backoff_ms;
+    int64_t max_backoff_ms;
+    // Number of times a request is attempted before giving up until the next
+    // time the app starts.
+    int max_attempts;
+  };
+
+  struct Metrics {
+    uint64_t requests;
+    uint64_t failures;
+    // Topics whose requests were abandoned after max_attempts.
+    uint64_t abandoned;
+    // Desired topics that were already confirmed, so needed no request.
+    uint64_t skipped;
+  };
+
+  // Create a manager which persists confirmed topics in the file at path.
+  TopicSubscriptionManager(const std::string& path,
+                           const RequestFunction& request,
+                           const Options& options);
+
+  // Set the topics the app should be subscribed to.
+  void SetDesiredTopics(const std::vector<std::string>& topics);
+
+  // Start any requests needed to reconcile the desired and confirmed topics
+  // that are due.  Call periodically so that failed requests are retried.
+  // Returns true if the confirmed topics match the desired topics.
+  bool Update();
+
+  // Forget the confirmed topics, e.g. because the registration token changed
+  // so the server no longer has any subscriptions for this app instance.
+  void ResetConfirmed();
+
+  Metrics GetMetrics() const;
+
+ private:
+  struct TopicState {
+    TopicState() : in_flight(false), attempts(0), next_attempt_ms(0) {}
+
+    bool in_flight;
+    int attempts;
+    int64_t next_attempt_ms;
+  };
+
+  struct Request {
+    std::string topic;
+    bool subscribe;
+  };
+
+  // Select the requests to start now.  Must be called with mutex_ held.
+  void SelectRequests(int64_t now_ms, std::vector<Request>* requests);
+  void OnComplete(const std::string& topic, bool subscribe, bool success);
+  void Load();
+  // Must be called with mutex_ held.
+  void Save();
+
+  const std::string path_;
+  const RequestFunction request_;
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  std::set<std::string> desired_;
+  std::set<std::string> confirmed_;
+  // Topics with outstanding work.
+  std::map<std::string, TopicState> states_;
+  size_t in_flight_;
+  // Guards against Update() being re-entered from a completion callback.
+  bool updating_;
+  bool update_requested_;
+  Metrics metrics_;
+};
+
+#endif  // FIREBASE_TESTAPP_TOPIC_SUBSCRIPTION_MANAGER_H_  // NOLINT
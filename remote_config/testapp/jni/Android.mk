@@ -39,6 +39,10 @@ include $(CLEAR_VARS)
 LOCAL_MODULE:=android_main
 LOCAL_SRC_FILES:=\
 	$(LOCAL_PATH)/src/common_main.cc \
+	$(LOCAL_PATH)/src/config_snapshot.cc \
+	$(LOCAL_PATH)/src/config_keys.cc \
+	$(LOCAL_PATH)/src/fetch_scheduler.cc \
+	$(LOCAL_PATH)/src/config_listeners.cc \
 	$(LOCAL_PATH)/src/android/android_main.cc
 LOCAL_STATIC_LIBRARIES:=\
 	firebase_remote_config \
@@ -13,6 +13,11 @@
 // limitations under the License.
 
 #include <assert.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
 
 #include "firebase/app.h"
 #include "firebase/remote_config.h"
@@ -23,11 +28,160 @@
 // Thin OS abstraction layer.
 #include "main.h"  // NOLINT
 
+#include "config_keys.h"  // NOLINT
+#include "config_listeners.h"  // NOLINT
+#include "config_snapshot.h"  // NOLINT
+#include "fetch_scheduler.h"  // NOLINT
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+#include "desktop/remote_config_benchmark.h"  // NOLINT
+#endif  // !defined(__ANDROID__) && !defined(__APPLE__)
+
+// Values the app reads, replaced each time fetched values are activated.
+static ConfigHolder g_config;
+// Notified of the keys that change each time a snapshot is published.
+static ConfigListeners g_listeners;
+
+// File the last activated snapshot is saved to, in the app's data directory.
+static std::string SnapshotPath() {
+  return std::string(GetDataPath()) + "/remote_config_snapshot";
+}
+
+// Log the values of the sample's keys in the current snapshot.
+static void LogValues(const char* label) {
+  namespace keys = config_keys;
+  std::shared_ptr<const ConfigSnapshot> config = g_config.Get();
+  LogMessage("%s TestBoolean %d", label,
+             keys::Get<keys::TestBoolean>(*config) ? 1 : 0);
+  LogMessage("%s TestLong %lld", label,  // NOLINT
+             static_cast<long long>(  // NOLINT
+                 keys::Get<keys::TestLong>(*config)));
+  LogMessage("%s TestDouble %f", label, keys::Get<keys::TestDouble>(*config));
+  LogMessage("%s TestString %s", label, keys::Get<keys::TestString>(*config));
+  DataView data = keys::Get<keys::TestData>(*config);
+  for (size_t i = 0; i < data.size; ++i) {
+    const unsigned char value = data[i];
+    LogMessage("TestData[%d] = 0x%02x (%c)", static_cast<int>(i), value,
+               value);
+  }
+}
+
+// Replace the current snapshot, notifying listeners of the keys that
+// changed.
+static void PublishConfig(std::shared_ptr<const ConfigSnapshot> snapshot) {
+  std::shared_ptr<const ConfigSnapshot> previous = g_config.Get();
+  g_config.Publish(snapshot);
+  const std::vector<ConfigChange> changes =
+      g_listeners.Notify(*previous, *snapshot);
+  LogMessage("Published config, %d keys changed",
+             static_cast<int>(changes.size()));
+}
+
+// Log each change, and rebuild state that depends on TestData only when it
+// changes.
+static void AddListeners() {
+  g_listeners.AddPrefixListener(
+      "", [](const ConfigSnapshot&, const std::vector<ConfigChange>& changes) {
+        static const char* kKinds[] = {"added", "changed", "removed"};
+        for (size_t i = 0; i < changes.size(); ++i) {
+          LogMessage("Config %s %s", changes[i].key.c_str(),
+                     kKinds[changes[i].kind]);
+        }
+      });
+  g_listeners.AddKeyListener(
+      config_keys::Name(config_keys::kTestData),
+      [](const ConfigSnapshot& snapshot, const std::vector<ConfigChange>&) {
+        DataView data = config_keys::Get<config_keys::TestData>(snapshot);
+        LogMessage("Rebuilding state from TestData (%d bytes)",
+                   static_cast<int>(data.size));
+      });
+}
+
+// Completion callbacks of the fetches in flight, by ID.  A fetch's future is
+// given the ID of its callback rather than owning it, so the callback of a
+// fetch that never completes, e.g. because Remote Config was terminated, is
+// still freed, and CancelFetches() can detach every callback before the
+// scheduler they call is destroyed.
+struct PendingFetches {
+  PendingFetches() : next_id(1) {}
+
+  std::mutex mutex;
+  std::map<uintptr_t, FetchScheduler::CompletionCallback> callbacks;
+  uintptr_t next_id;
+};
+static PendingFetches g_pending_fetches;
+
+// Start a fetch, passing its result to complete.
+static void FetchRemoteConfig(
+    uint64_t cache_expiration_s,
+    const FetchScheduler::CompletionCallback& complete) {
+  uintptr_t id;
+  {
+    std::lock_guard<std::mutex> lock(g_pending_fetches.mutex);
+    id = g_pending_fetches.next_id++;
+    g_pending_fetches.callbacks[id] = complete;
+  }
+  LogMessage("Fetch...");
+  ::firebase::Future<void> future =
+      ::firebase::remote_config::Fetch(cache_expiration_s);
+  future.OnCompletion(
+      [](const ::firebase::Future<void>& result, void* user_data) {
+        namespace remote_config = ::firebase::remote_config;
+        const remote_config::ConfigInfo& info = remote_config::GetInfo();
+        FetchScheduler::FetchResult fetch_result;
+        fetch_result.success =
+            result.Status() == ::firebase::kFutureStatusComplete &&
+            result.Error() == 0 &&
+            info.last_fetch_status == remote_config::kLastFetchStatusSuccess;
+        fetch_result.throttled = info.last_fetch_failure_reason ==
+                                 remote_config::kFetchFailureReasonThrottled;
+        fetch_result.throttled_end_time = info.throttled_end_time;
+        LogMessage("Fetch %s", fetch_result.success ? "Complete" : "Failed");
+        // The callback is called with the lock held, so CancelFetches()
+        // waits for it to return.
+        std::lock_guard<std::mutex> lock(g_pending_fetches.mutex);
+        auto it = g_pending_fetches.callbacks.find(
+            reinterpret_cast<uintptr_t>(user_data));
+        if (it == g_pending_fetches.callbacks.end()) return;
+        FetchScheduler::CompletionCallback complete = std::move(it->second);
+        g_pending_fetches.callbacks.erase(it);
+        complete(fetch_result);
+      },
+      reinterpret_cast<void*>(id));
+}
+
+// Free the callbacks of fetches still in flight, so they're never called.
+static void CancelFetches() {
+  std::lock_guard<std::mutex> lock(g_pending_fetches.mutex);
+  g_pending_fetches.callbacks.clear();
+}
+
 // Execute all methods of the C++ Remote Config API.
 extern "C" int common_main(int argc, const char* argv[]) {
   namespace remote_config = ::firebase::remote_config;
   ::firebase::App* app;
 
+  AddListeners();
+
+  // Map the values activated when the app last ran, so they can be read
+  // before the Firebase app and Remote Config are initialized.
+  {
+    const auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const ConfigSnapshot> last_known_good =
+        ConfigSnapshot::Load(SnapshotPath(), config_keys::Names());
+    const auto end = std::chrono::steady_clock::now();
+    if (last_known_good) {
+      PublishConfig(std::move(last_known_good));
+      LogMessage("Loaded last known good config in %dus",
+                 static_cast<int>(
+                     std::chrono::duration_cast<std::chrono::microseconds>(
+                         end - start)
+                         .count()));
+      LogValues("Last known good");
+    } else {
+      LogMessage("No last known good config, using defaults");
+    }
+  }
+
   LogMessage("Initialize the Firebase Remote Config library");
 #if defined(__ANDROID__)
   app = ::firebase::App::Create(::firebase::AppOptions(), GetJniEnv(),
@@ -75,40 +229,27 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   LogMessage("Initialized the Firebase Remote Config API");
 
-  static const remote_config::ConfigKeyValue defaults[] = {
-      {"TestBoolean", "True"},
-      {"TestLong", "42"},
-      {"TestDouble", "3.14"},
-      {"TestString", "Hello World"},
-      {"TestData", "abcde"}};
-  size_t default_count = sizeof(defaults) / sizeof(defaults[0]);
-  remote_config::SetDefaults(defaults, default_count);
-
-  // The return values may not be the set defaults, if a fetch was previously
-  // completed for the app that set them.
-  {
-    bool result = remote_config::GetBoolean("TestBoolean");
-    LogMessage("Get TestBoolean %d", result ? 1 : 0);
-  }
-  {
-    int64_t result = remote_config::GetLong("TestLong");
-    LogMessage("Get TestLong %lld", result);
-  }
-  {
-    double result = remote_config::GetDouble("TestDouble");
-    LogMessage("Get TestDouble %f", result);
-  }
-  {
-    std::string result = remote_config::GetString("TestString");
-    LogMessage("Get TestString %s", result.c_str());
-  }
-  {
-    std::vector<unsigned char> result = remote_config::GetData("TestData");
-    for (size_t i = 0; i < result.size(); ++i) {
-      const unsigned char value = result[i];
-      LogMessage("TestData[%d] = 0x%02x (%c)", i, value, value);
-    }
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+  // On desktop the app can benchmark its config reads rather than running
+  // the sample.
+  if (RemoteConfigBenchmarkRequested(argc, argv)) {
+    const int result = RunRemoteConfigBenchmark(argc, argv);
+    remote_config::Terminate();
+    delete app;
+    return result;
   }
+#endif  // !defined(__ANDROID__) && !defined(__APPLE__)
+
+  // Set the defaults declared with each key in config_keys.h.
+  config_keys::SetDefaults();
+
+  // Read every value once into a snapshot.  The values may not be the set
+  // defaults, if a fetch was previously completed for the app that set them.
+  // The snapshot is created with the registry's keys first, so each key's
+  // index in the snapshot is its index in the registry.
+  const std::vector<std::string> keys = config_keys::Names();
+  PublishConfig(ConfigSnapshot::FromRemoteConfig(keys));
+  LogValues("Get");
 
   // Enable developer mode and verified it's enabled.
   // NOTE: Developer mode should not be enabled in production applications.
@@ -118,57 +259,44 @@ extern "C" int common_main(int argc, const char* argv[]) {
               remote_config::kConfigSettingDeveloperMode)
               .c_str() == '1');
 
-  LogMessage("Fetch...");
-  auto future_result = remote_config::Fetch(0);
-  while (future_result.Status() == firebase::kFutureStatusPending) {
-    if (ProcessEvents(1000)) {
-      break;
-    }
-  }
-
-  if (future_result.Status() == firebase::kFutureStatusComplete) {
-    LogMessage("Fetch Complete");
-    bool activate_result = remote_config::ActivateFetched();
-    LogMessage("ActivateFetched %s", activate_result ? "succeeded" : "failed");
-
+  // Fetch in the background rather than waiting for the result, and
+  // activate the fetched values at the next Update().  The app keeps reading
+  // the previous snapshot until the new values are published.
+  FetchScheduler::Options fetch_options;
+  fetch_options.initial_delay_ms = 1000;
+  // Developer mode allows fetching without the cache.
+  fetch_options.cache_expiration_s = 0;
+  FetchScheduler fetch_scheduler(FetchRemoteConfig,
+                                 remote_config::ActivateFetched,
+                                 fetch_options);
+  fetch_scheduler.Subscribe([&keys]() {
+    LogMessage("ActivateFetched succeeded");
     const remote_config::ConfigInfo& info = remote_config::GetInfo();
     LogMessage("Info last_fetch_time_ms=%d fetch_status=%d failure_reason=%d",
                static_cast<int>(info.fetch_time), info.last_fetch_status,
                info.last_fetch_failure_reason);
 
-    // Print out the new values, which may be updated from the Fetch.
-    {
-      bool result = remote_config::GetBoolean("TestBoolean");
-      LogMessage("Updated TestBoolean %d", result ? 1 : 0);
+    // Replace the snapshot with the new values.  Anything still reading the
+    // previous snapshot is unaffected, and listeners are only called for
+    // keys whose values changed.
+    std::shared_ptr<const ConfigSnapshot> snapshot =
+        ConfigSnapshot::FromRemoteConfig(keys);
+    PublishConfig(snapshot);
+    LogValues("Updated");
+    // Keep the values for the next launch.
+    if (!snapshot->Save(SnapshotPath())) {
+      LogMessage("Failed to save config to %s", SnapshotPath().c_str());
     }
-    {
-      int64_t result = remote_config::GetLong("TestLong");
-      LogMessage("Updated TestLong %lld", result);
-    }
-    {
-      double result = remote_config::GetDouble("TestDouble");
-      LogMessage("Updated TestDouble %f", result);
-    }
-    {
-      std::string result = remote_config::GetString("TestString");
-      LogMessage("Updated TestString %s", result.c_str());
-    }
-    {
-      std::vector<unsigned char> result = remote_config::GetData("TestData");
-      for (size_t i = 0; i < result.size(); ++i) {
-        const unsigned char value = result[i];
-        LogMessage("TestData[%d] = 0x%02x (%c)", i, value, value);
-      }
-    }
-  }
-  // Release a handle to the future so we can shutdown the Remote Config API
-  // when exiting the app.  Alternatively we could have placed future_result
-  // in a scope different to our shutdown code below.
-  future_result.Release();
+  });
+  fetch_scheduler.Start();
 
   // Wait until the user wants to quit the app.
   while (!ProcessEvents(1000)) {
+    fetch_scheduler.Update();
   }
+  // A fetch may still be in flight, and its callback calls the scheduler.
+  CancelFetches();
+  fetch_scheduler.LogMetrics();
 
   remote_config::Terminate();
   delete app;
@@ -0,0 +1,64 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "config_keys.h"  // NOLINT
+
+#include <string.h>
+
+#include "firebase/remote_config.h"
+
+namespace config_keys {
+
+namespace {
+
+// Name() is a chain of comparisons, so names are looked up in an array at
+// runtime.
+const char* const kNames[] = {
+#define CONFIG_KEYS_NAME(name, type, value) #name,
+    CONFIG_KEYS(CONFIG_KEYS_NAME)
+#undef CONFIG_KEYS_NAME
+};
+
+}  // namespace
+
+size_t Find(const char* name) {
+  uint32_t hash = kHashBasis;
+  for (const char* c = name; *c; ++c) {
+    hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+  }
+  const size_t bucket = hash & (kTableSize - 1);
+  for (size_t i = HashTable::kStart[bucket]; i < HashTable::kStart[bucket + 1];
+       ++i) {
+    const size_t index = HashTable::kKeys[i];
+    if (strcmp(kNames[index], name) == 0) return index;
+  }
+  return kNotFound;
+}
+
+std::vector<std::string> Names() {
+  std::vector<std::string> names;
+  for (size_t i = 0; i < kNumKeys; ++i) names.push_back(kNames[i]);
+  return names;
+}
+
+void SetDefaults() {
+  static const ::firebase::remote_config::ConfigKeyValue kDefaults[] = {
+#define CONFIG_KEYS_DEFAULT(name, type, value) {#name, value},
+      CONFIG_KEYS(CONFIG_KEYS_DEFAULT)
+#undef CONFIG_KEYS_DEFAULT
+  };
+  ::firebase::remote_config::SetDefaults(kDefaults, kNumKeys);
+}
+
+}  // namespace config_keys
@@ -0,0 +1,257 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_CONFIG_KEYS_H_  // NOLINT
+#define FIREBASE_TESTAPP_CONFIG_KEYS_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "config_snapshot.h"  // NOLINT
+
+// Every config key the app reads, declared once as
+// X(name, type, default value).  type is one of bool, int64_t, double,
+// const char* or DataView.
+#define CONFIG_KEYS(X)                      \
+  X(TestBoolean, bool, "True")              \
+  X(TestLong, int64_t, "42")                \
+  X(TestDouble, double, "3.14")             \
+  X(TestString, const char*, "Hello World") \
+  X(TestData, DataView, "abcde")
+
+// Registry generated from CONFIG_KEYS.
+//
+// Each key is a type, read with Get<>(), e.g.
+//   int64_t value = config_keys::Get<config_keys::TestLong>(*snapshot);
+// so a misspelled key or wrong type doesn't compile.  A key's index is a
+// compile time constant matching its index in snapshots created with
+// Names(), so a read is a single array index.  Keys only known at runtime,
+// such as keys in fetched values, are looked up with Find(), which uses a
+// hash table built at compile time.
+namespace config_keys {
+
+enum Index {
+#define CONFIG_KEYS_INDEX(name, type, value) k##name,
+  CONFIG_KEYS(CONFIG_KEYS_INDEX)
+#undef CONFIG_KEYS_INDEX
+  kNumKeys
+};
+
+// Returned by Find() for keys that aren't in the registry.
+static const size_t kNotFound = static_cast<size_t>(-1);
+
+// Name and default value of the key with index i.
+constexpr const char* Name(size_t i) {
+  return
+#define CONFIG_KEYS_NAME(name, type, value) i == k##name ? #name :
+      CONFIG_KEYS(CONFIG_KEYS_NAME)
+#undef CONFIG_KEYS_NAME
+      nullptr;
+}
+constexpr const char* DefaultValue(size_t i) {
+  return
+#define CONFIG_KEYS_DEFAULT(name, type, value) i == k##name ? value :
+      CONFIG_KEYS(CONFIG_KEYS_DEFAULT)
+#undef CONFIG_KEYS_DEFAULT
+      nullptr;
+}
+
+// Base of each key's type.
+template <size_t I, typename T>
+struct Key {
+  typedef T Type;
+  static const size_t kIndex = I;
+};
+
+#define CONFIG_KEYS_TYPE(name, type, value) \
+  struct name : Key<k##name, type> {};
+CONFIG_KEYS(CONFIG_KEYS_TYPE)
+#undef CONFIG_KEYS_TYPE
+
+inline bool Read(const ConfigSnapshot& snapshot, size_t i, bool*) {
+  return snapshot.GetBoolean(i);
+}
+inline int64_t Read(const ConfigSnapshot& snapshot, size_t i, int64_t*) {
+  return snapshot.GetLong(i);
+}
+inline double Read(const ConfigSnapshot& snapshot, size_t i, double*) {
+  return snapshot.GetDouble(i);
+}
+inline const char* Read(const ConfigSnapshot& snapshot, size_t i,
+                        const char**) {
+  return snapshot.GetString(i);
+}
+inline DataView Read(const ConfigSnapshot& snapshot, size_t i, DataView*) {
+  return snapshot.GetData(i);
+}
+
+// Value of key K in snapshot, which must have been created with Names().
+template <typename K>
+typename K::Type Get(const ConfigSnapshot& snapshot) {
+  return Read(snapshot, K::kIndex, static_cast<typename K::Type*>(nullptr));
+}
+
+// Check at compile time that each default parses as its key's type, using
+// the same rules as Remote Config.
+constexpr char Lower(char c) {
+  return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+constexpr bool EqualsIgnoreCase(const char* a, const char* b) {
+  return Lower(*a) == Lower(*b) && (!*a || EqualsIgnoreCase(a + 1, b + 1));
+}
+constexpr bool IsDigits(const char* s) {
+  return *s >= '0' && *s <= '9' && (!s[1] || IsDigits(s + 1));
+}
+constexpr bool IsInteger(const char* s) {
+  return IsDigits(*s == '-' || *s == '+' ? s + 1 : s);
+}
+// Digits with at most one decimal point, and at least one digit.
+constexpr bool IsDecimal(const char* s, bool point, bool digit) {
+  return !*s ? digit
+             : *s == '.' ? !point && IsDecimal(s + 1, true, digit)
+                         : *s >= '0' && *s <= '9' &&
+                               IsDecimal(s + 1, point, true);
+}
+constexpr bool IsValid(const char* value, bool*) {
+  return EqualsIgnoreCase(value, "1") || EqualsIgnoreCase(value, "true") ||
+         EqualsIgnoreCase(value, "t") || EqualsIgnoreCase(value, "yes") ||
+         EqualsIgnoreCase(value, "y") || EqualsIgnoreCase(value, "on") ||
+         EqualsIgnoreCase(value, "0") || EqualsIgnoreCase(value, "false") ||
+         EqualsIgnoreCase(value, "f") || EqualsIgnoreCase(value, "no") ||
+         EqualsIgnoreCase(value, "n") || EqualsIgnoreCase(value, "off");
+}
+constexpr bool IsValid(const char* value, int64_t*) {
+  return IsInteger(value);
+}
+constexpr bool IsValid(const char* value, double*) {
+  return IsDecimal(*value == '-' || *value == '+' ? value + 1 : value, false,
+                   false);
+}
+constexpr bool IsValid(const char*, const char**) { return true; }
+constexpr bool IsValid(const char*, DataView*) { return true; }
+
+#define CONFIG_KEYS_CHECK(name, type, value)                 \
+  static_assert(IsValid(value, static_cast<type*>(nullptr)), \
+                "Default value of " #name " is not a valid " #type);
+CONFIG_KEYS(CONFIG_KEYS_CHECK)
+#undef CONFIG_KEYS_CHECK
+
+// Keys are stored as uint8_t indices in the hash table.
+static_assert(kNumKeys > 0 && kNumKeys < 256,
+              "The registry supports between 1 and 255 keys");
+
+// FNV-1a hash of a key.  Find() computes the same hash at runtime.
+constexpr uint32_t Hash(const char* s, uint32_t hash) {
+  return *s ? Hash(s + 1, (hash ^ static_cast<uint8_t>(*s)) * 16777619u)
+            : hash;
+}
+constexpr uint32_t kHashBasis = 2166136261u;
+// Smallest power of two that's at least twice the number of keys, so
+// buckets hold less than one key on average.
+constexpr size_t TableSize(size_t size) {
+  return size >= 2 * kNumKeys ? size : TableSize(size * 2);
+}
+constexpr size_t kTableSize = TableSize(1);
+constexpr size_t Bucket(const char* name) {
+  return Hash(name, kHashBasis) & (kTableSize - 1);
+}
+
+// The hash table is built at compile time from arrays generated by
+// expanding index sequences.  Keys are ordered by bucket, so the keys in
+// bucket b are kKeys[kStart[b]] to kKeys[kStart[b + 1] - 1].  Building it
+// never fails, and takes O(kNumKeys * kTableSize) steps, each recursing at
+// most log2(kNumKeys) deep.
+template <size_t... I>
+struct IndexSequence {};
+template <size_t N, size_t... I>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+template <size_t... I>
+struct MakeIndexSequence<0, I...> {
+  typedef IndexSequence<I...> Type;
+};
+
+// Bucket of each key, computed once.
+template <typename Sequence>
+struct KeyBuckets;
+template <size_t... I>
+struct KeyBuckets<IndexSequence<I...>> {
+  static constexpr size_t kBuckets[sizeof...(I)] = {Bucket(Name(I))...};
+};
+template <size_t... I>
+constexpr size_t KeyBuckets<IndexSequence<I...>>::kBuckets[sizeof...(I)];
+typedef KeyBuckets<MakeIndexSequence<kNumKeys>::Type> Buckets;
+
+// Number of keys in [begin, end) ordered before bucket and then index.
+constexpr size_t CountBefore(size_t bucket, size_t index, size_t begin,
+                             size_t end) {
+  return end - begin == 1
+             ? (Buckets::kBuckets[begin] < bucket ||
+                (Buckets::kBuckets[begin] == bucket && begin < index))
+             : CountBefore(bucket, index, begin, (begin + end) / 2) +
+                   CountBefore(bucket, index, (begin + end) / 2, end);
+}
+// Position of each key in the table.
+template <typename Sequence>
+struct KeyPositions;
+template <size_t... I>
+struct KeyPositions<IndexSequence<I...>> {
+  static constexpr size_t kPositions[sizeof...(I)] = {
+      CountBefore(Buckets::kBuckets[I], I, 0, kNumKeys)...};
+};
+template <size_t... I>
+constexpr size_t KeyPositions<IndexSequence<I...>>::kPositions[sizeof...(I)];
+typedef KeyPositions<MakeIndexSequence<kNumKeys>::Type> Positions;
+
+// One more than the index of the key in [begin, end) at position, or 0 if
+// there isn't one.  Exactly one key is at each position.
+constexpr size_t KeyAt(size_t position, size_t begin, size_t end) {
+  return end - begin == 1
+             ? (Positions::kPositions[begin] == position ? begin + 1 : 0)
+             : KeyAt(position, begin, (begin + end) / 2) +
+                   KeyAt(position, (begin + end) / 2, end);
+}
+template <typename Keys, typename Buckets>
+struct Table;
+template <size_t... K, size_t... B>
+struct Table<IndexSequence<K...>, IndexSequence<B...>> {
+  static constexpr uint8_t kKeys[sizeof...(K)] = {
+      static_cast<uint8_t>(KeyAt(K, 0, kNumKeys) - 1)...};
+  static constexpr uint8_t kStart[sizeof...(B)] = {
+      static_cast<uint8_t>(CountBefore(B, 0, 0, kNumKeys))...};
+};
+template <size_t... K, size_t... B>
+constexpr uint8_t
+    Table<IndexSequence<K...>, IndexSequence<B...>>::kKeys[sizeof...(K)];
+template <size_t... K, size_t... B>
+constexpr uint8_t
+    Table<IndexSequence<K...>, IndexSequence<B...>>::kStart[sizeof...(B)];
+typedef Table<MakeIndexSequence<kNumKeys>::Type,
+              MakeIndexSequence<kTableSize + 1>::Type>
+    HashTable;
+
+// Index of the key called name, or kNotFound.
+size_t Find(const char* name);
+
+// Names of all keys in index order, to create snapshots with.
+std::vector<std::string> Names();
+
+// Pass every key's default value to remote_config::SetDefaults().
+void SetDefaults();
+
+}  // namespace config_keys
+
+#endif  // FIREBASE_TESTAPP_CONFIG_KEYS_H_  // NOLINT
@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "config_listeners.h"  // NOLINT
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+// Index of the key with index in from, in snapshot.
+size_t FindKey(const ConfigSnapshot& from, size_t index,
+               const ConfigSnapshot& snapshot) {
+  const char* key = from.key(index);
+  return index < snapshot.size() && strcmp(snapshot.key(index), key) == 0
+             ? index
+             : snapshot.Find(key);
+}
+
+bool ValuesEqual(const ConfigSnapshot& a, size_t a_index,
+                 const ConfigSnapshot& b, size_t b_index) {
+  const double a_double = a.GetDouble(a_index);
+  const double b_double = b.GetDouble(b_index);
+  const DataView a_data = a.GetData(a_index);
+  const DataView b_data = b.GetData(b_index);
+  const size_t string_size = a.GetStringSize(a_index);
+  // Doubles are compared bitwise, so NaN equals itself.
+  return a.GetBoolean(a_index) == b.GetBoolean(b_index) &&
+         a.GetLong(a_index) == b.GetLong(b_index) &&
+         memcmp(&a_double, &b_double, sizeof(a_double)) == 0 &&
+         string_size == b.GetStringSize(b_index) &&
+         memcmp(a.GetString(a_index), b.GetString(b_index), string_size) ==
+             0 &&
+         a_data.size == b_data.size &&
+         (a_data.empty() ||
+          memcmp(a_data.data, b_data.data, a_data.size) == 0);
+}
+
+}  // namespace
+
+std::vector<ConfigChange> DiffSnapshots(const ConfigSnapshot& old_snapshot,
+                                        const ConfigSnapshot& new_snapshot) {
+  std::vector<ConfigChange> changes;
+  for (size_t i = 0; i < new_snapshot.size(); ++i) {
+    const size_t old_index = FindKey(new_snapshot, i, old_snapshot);
+    if (old_index == ConfigSnapshot::kNotFound) {
+      changes.push_back(
+          ConfigChange(new_snapshot.key(i), ConfigChange::kAdded));
+    } else if (!ValuesEqual(old_snapshot, old_index, new_snapshot, i)) {
+      changes.push_back(
+          ConfigChange(new_snapshot.key(i), ConfigChange::kChanged));
+    }
+  }
+  for (size_t i = 0; i < old_snapshot.size(); ++i) {
+    if (FindKey(old_snapshot, i, new_snapshot) == ConfigSnapshot::kNotFound) {
+      changes.push_back(
+          ConfigChange(old_snapshot.key(i), ConfigChange::kRemoved));
+    }
+  }
+  return changes;
+}
+
+ConfigListeners::ConfigListeners() : next_id_(0) {}
+
+int ConfigListeners::AddKeyListener(const std::string& key,
+                                    const Listener& listener) {
+  return Add(key, false, listener);
+}
+
+int ConfigListeners::AddPrefixListener(const std::string& prefix,
+                                       const Listener& listener) {
+  return Add(prefix, true, listener);
+}
+
+int ConfigListeners::Add(const std::string& key, bool prefix,
+                         const Listener& listener) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Registration registration;
+  registration.id = next_id_++;
+  registration.key = key;
+  registration.prefix = prefix;
+  registration.listener = listener;
+  registrations_.push_back(registration);
+  return registration.id;
+}
+
+void ConfigListeners::RemoveListener(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  registrations_.erase(
+      std::remove_if(registrations_.begin(), registrations_.end(),
+                     [id](const Registration& registration) {
+                       return registration.id == id;
+                     }),
+      registrations_.end());
+}
+
+std::vector<ConfigChange> ConfigListeners::Notify(
+    const ConfigSnapshot& old_snapshot, const ConfigSnapshot& new_snapshot) {
+  std::vector<ConfigChange> changes =
+      DiffSnapshots(old_snapshot, new_snapshot);
+  if (changes.empty()) return changes;
+  std::vector<Registration> registrations;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    registrations = registrations_;
+  }
+  std::vector<ConfigChange> matches;
+  for (size_t i = 0; i < registrations.size(); ++i) {
+    const Registration& registration = registrations[i];
+    matches.clear();
+    for (size_t j = 0; j < changes.size(); ++j) {
+      const std::string& key = changes[j].key;
+      if (registration.prefix
+              ? key.compare(0, registration.key.size(), registration.key) == 0
+              : key == registration.key) {
+        matches.push_back(changes[j]);
+      }
+    }
+    if (!matches.empty()) registration.listener(new_snapshot, matches);
+  }
+  return changes;
+}
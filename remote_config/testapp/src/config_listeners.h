@@ -0,0 +1,94 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_CONFIG_LISTENERS_H_  // NOLINT
+#define FIREBASE_TESTAPP_CONFIG_LISTENERS_H_  // NOLINT
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "config_snapshot.h"  // NOLINT
+
+// A key whose value differs between two snapshots.
+struct ConfigChange {
+  enum Kind {
+    kAdded,
+    kChanged,
+    kRemoved,
+  };
+
+  ConfigChange(const std::string& changed_key, Kind change_kind)
+      : key(changed_key), kind(change_kind) {}
+
+  std::string key;
+  Kind kind;
+};
+
+// Keys whose values differ between old_snapshot and new_snapshot, in
+// new_snapshot's index order followed by removed keys.  A value differs if
+// any of its representations differ.  Keys with the same index in both
+// snapshots, such as the registry's keys, are compared without a lookup.
+std::vector<ConfigChange> DiffSnapshots(const ConfigSnapshot& old_snapshot,
+                                        const ConfigSnapshot& new_snapshot);
+
+// Listeners for changes to individual keys, or to every key starting with
+// a prefix.
+//
+// Notify() is called with the previous and new snapshots each time values
+// are activated.  It diffs them once, and calls each listener only if a key
+// it's registered for changed, so dependent state such as a table parsed
+// from a data value is only rebuilt when its value changes.
+//
+// Listeners are called on the thread that calls Notify(), and may add or
+// remove listeners.  Other methods are thread safe.
+class ConfigListeners {
+ public:
+  // Called with the new snapshot and the changes matching the listener.
+  typedef std::function<void(const ConfigSnapshot& snapshot,
+                             const std::vector<ConfigChange>& changes)>
+      Listener;
+
+  ConfigListeners();
+
+  // Call listener when key changes.  Returns an ID to remove it with.
+  int AddKeyListener(const std::string& key, const Listener& listener);
+  // Call listener when any key starting with prefix changes.  An empty
+  // prefix matches every key.
+  int AddPrefixListener(const std::string& prefix, const Listener& listener);
+  void RemoveListener(int id);
+
+  // Diff the snapshots and notify the listeners of matching changes.
+  // Returns the diff.
+  std::vector<ConfigChange> Notify(const ConfigSnapshot& old_snapshot,
+                                   const ConfigSnapshot& new_snapshot);
+
+ private:
+  struct Registration {
+    int id;
+    std::string key;
+    // If set, key is a prefix.
+    bool prefix;
+    Listener listener;
+  };
+
+  int Add(const std::string& key, bool prefix, const Listener& listener);
+
+  std::mutex mutex_;
+  std::vector<Registration> registrations_;
+  int next_id_;
+};
+
+#endif  // FIREBASE_TESTAPP_CONFIG_LISTENERS_H_  // NOLINT
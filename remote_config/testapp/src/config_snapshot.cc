@@ -0,0 +1,320 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "config_snapshot.h"  // NOLINT
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <set>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // !defined(_WIN32)
+
+#include "firebase/remote_config.h"
+
+namespace {
+
+const char kMagic[8] = {'r', 'c', 's', 'n', 'a', 'p', 's', 'h'};
+// Changed if the arena layout changes.
+const uint32_t kVersion = 1;
+
+// Start of a snapshot file, followed by the arena.
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t arena_size;
+  // Checksum() of the arena, so a corrupt file isn't used.
+  uint32_t checksum;
+  // Keeps the arena aligned.
+  uint32_t reserved;
+};
+
+// FNV-1a hash of size bytes of data.
+uint32_t Checksum(const char* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+// Round size up to a multiple of ConfigSnapshot::kDataAlignment.
+size_t Align(size_t size) {
+  return (size + ConfigSnapshot::kDataAlignment - 1) &
+         ~(ConfigSnapshot::kDataAlignment - 1);
+}
+
+}  // namespace
+
+std::shared_ptr<const ConfigSnapshot> ConfigSnapshot::Create(
+    const std::vector<std::pair<std::string, ConfigValue>>& values) {
+  const size_t num_entries = values.size();
+  const size_t table_size = Align(sizeof(Header) +
+                                  num_entries * sizeof(Entry) +
+                                  num_entries * sizeof(uint32_t));
+  // Data is stored first, each aligned, followed by the keys and strings.
+  size_t arena_size = table_size;
+  for (size_t i = 0; i < num_entries; ++i) {
+    arena_size += Align(values[i].second.data.size());
+  }
+  for (size_t i = 0; i < num_entries; ++i) {
+    arena_size += values[i].first.size() + 1 +
+                  values[i].second.string_value.size() + 1;
+  }
+
+  std::shared_ptr<char> arena(new char[arena_size](),
+                              std::default_delete<char[]>());
+  Header* header = reinterpret_cast<Header*>(arena.get());
+  header->arena_size = static_cast<uint32_t>(arena_size);
+  header->num_entries = static_cast<uint32_t>(num_entries);
+  Entry* entries = reinterpret_cast<Entry*>(arena.get() + sizeof(Header));
+  uint32_t* sorted = reinterpret_cast<uint32_t*>(entries + num_entries);
+
+  uint32_t offset = static_cast<uint32_t>(table_size);
+  auto append = [&arena, &offset](const void* data, size_t size,
+                                  size_t padded_size, Span* span) {
+    span->offset = offset;
+    span->size = static_cast<uint32_t>(size);
+    if (size) memcpy(arena.get() + offset, data, size);
+    // The arena is zero filled, so skipping a byte terminates a string.
+    offset += static_cast<uint32_t>(padded_size);
+  };
+  for (size_t i = 0; i < num_entries; ++i) {
+    const std::vector<unsigned char>& data = values[i].second.data;
+    append(data.data(), data.size(), Align(data.size()), &entries[i].data);
+  }
+  for (size_t i = 0; i < num_entries; ++i) {
+    const ConfigValue& value = values[i].second;
+    Entry* entry = &entries[i];
+    append(values[i].first.data(), values[i].first.size(),
+           values[i].first.size() + 1, &entry->key);
+    append(value.string_value.data(), value.string_value.size(),
+           value.string_value.size() + 1, &entry->string_value);
+    entry->long_value = value.long_value;
+    entry->double_value = value.double_value;
+    entry->boolean = value.boolean ? 1 : 0;
+    sorted[i] = static_cast<uint32_t>(i);
+  }
+  std::sort(sorted, sorted + num_entries, [&values](uint32_t a, uint32_t b) {
+    return values[a].first < values[b].first;
+  });
+  const char* data = arena.get();
+  return std::shared_ptr<const ConfigSnapshot>(
+      new ConfigSnapshot(std::move(arena), data));
+}
+
+std::shared_ptr<const ConfigSnapshot> ConfigSnapshot::FromRemoteConfig(
+    const std::vector<std::string>& keys) {
+  namespace remote_config = ::firebase::remote_config;
+  std::vector<std::string> all_keys;
+  std::set<std::string> seen;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (seen.insert(keys[i]).second) all_keys.push_back(keys[i]);
+  }
+  std::vector<std::string> other_keys = remote_config::GetKeys();
+  for (size_t i = 0; i < other_keys.size(); ++i) {
+    if (seen.insert(other_keys[i]).second) all_keys.push_back(other_keys[i]);
+  }
+
+  std::vector<std::pair<std::string, ConfigValue>> values(all_keys.size());
+  for (size_t i = 0; i < all_keys.size(); ++i) {
+    const char* key = all_keys[i].c_str();
+    ConfigValue& value = values[i].second;
+    values[i].first = all_keys[i];
+    value.boolean = remote_config::GetBoolean(key);
+    value.long_value = remote_config::GetLong(key);
+    value.double_value = remote_config::GetDouble(key);
+    value.string_value = remote_config::GetString(key);
+    value.data = remote_config::GetData(key);
+  }
+  return Create(values);
+}
+
+size_t ConfigSnapshot::Find(const char* key) const {
+  const uint32_t* begin = sorted();
+  const uint32_t* end = begin + size();
+  const uint32_t* it =
+      std::lower_bound(begin, end, key, [this](uint32_t index, const char* k) {
+        return strcmp(this->key(index), k) < 0;
+      });
+  return it != end && strcmp(this->key(*it), key) == 0 ? *it : kNotFound;
+}
+
+const char* ConfigSnapshot::key(size_t index) const {
+  return index < size() ? arena_ + entries()[index].key.offset : "";
+}
+
+const char* ConfigSnapshot::GetString(size_t index) const {
+  return index < size() ? arena_ + entries()[index].string_value.offset
+                        : "";
+}
+
+DataView ConfigSnapshot::GetData(size_t index) const {
+  if (index >= size()) return DataView();
+  const Span& data = entries()[index].data;
+  return DataView(
+      reinterpret_cast<const unsigned char*>(arena_ + data.offset),
+      data.size);
+}
+
+bool ConfigSnapshot::Validate(const char* arena, size_t size) {
+  if (size < sizeof(Header)) return false;
+  const Header* header = reinterpret_cast<const Header*>(arena);
+  const size_t num_entries = header->num_entries;
+  if (header->arena_size != size ||
+      num_entries > (size - sizeof(Header)) /
+                        (sizeof(Entry) + sizeof(uint32_t))) {
+    return false;
+  }
+  const Entry* entries =
+      reinterpret_cast<const Entry*>(arena + sizeof(Header));
+  const uint32_t* sorted =
+      reinterpret_cast<const uint32_t*>(entries + num_entries);
+  const size_t table_size =
+      reinterpret_cast<const char*>(sorted + num_entries) - arena;
+  // Strings must be null terminated within the arena.
+  auto valid_string = [arena, size, table_size](const Span& span) {
+    return span.offset >= table_size && span.offset < size &&
+           span.size < size - span.offset &&
+           arena[span.offset + span.size] == 0;
+  };
+  for (size_t i = 0; i < num_entries; ++i) {
+    const Entry& entry = entries[i];
+    if (!valid_string(entry.key) || !valid_string(entry.string_value) ||
+        entry.data.offset < table_size || entry.data.offset > size ||
+        entry.data.size > size - entry.data.offset ||
+        entry.data.offset % kDataAlignment != 0 || sorted[i] >= num_entries) {
+      return false;
+    }
+  }
+  // Find() relies on the index listing keys in strictly ascending order,
+  // which also means it's a permutation of the entries.
+  for (size_t i = 1; i < num_entries; ++i) {
+    if (strcmp(arena + entries[sorted[i - 1]].key.offset,
+               arena + entries[sorted[i]].key.offset) >= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#if !defined(_WIN32)
+
+std::shared_ptr<const ConfigSnapshot> ConfigSnapshot::Load(
+    const std::string& path, const std::vector<std::string>& keys) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat status;
+  void* mapping = MAP_FAILED;
+  size_t file_size = 0;
+  if (fstat(fd, &status) == 0 &&
+      static_cast<size_t>(status.st_size) > sizeof(FileHeader)) {
+    file_size = static_cast<size_t>(status.st_size);
+    mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) return nullptr;
+  // The mapping is released with the last reference to the snapshot.
+  std::shared_ptr<const void> storage(
+      mapping, [file_size](const void* data) {
+        munmap(const_cast<void*>(data), file_size);
+      });
+  const char* file = static_cast<const char*>(mapping);
+
+#else
+
+// Windows doesn't have mmap(), so the file is read into memory.
+std::shared_ptr<const ConfigSnapshot> ConfigSnapshot::Load(
+    const std::string& path, const std::vector<std::string>& keys) {
+  FILE* input = fopen(path.c_str(), "rb");
+  if (!input) return nullptr;
+  std::string contents;
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), input)) > 0) {
+    contents.append(buffer, read);
+  }
+  fclose(input);
+  const size_t file_size = contents.size();
+  std::shared_ptr<char> data(new char[file_size + 1],
+                             std::default_delete<char[]>());
+  memcpy(data.get(), contents.data(), file_size);
+  const char* file = data.get();
+  std::shared_ptr<const void> storage(std::move(data));
+
+#endif  // !defined(_WIN32)
+
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(file);
+  const char* arena = file + sizeof(FileHeader);
+  if (file_size < sizeof(FileHeader) ||
+      memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion ||
+      header->arena_size != file_size - sizeof(FileHeader) ||
+      header->checksum != Checksum(arena, header->arena_size) ||
+      !Validate(arena, header->arena_size)) {
+    return nullptr;
+  }
+  std::shared_ptr<const ConfigSnapshot> snapshot(
+      new ConfigSnapshot(std::move(storage), arena));
+  if (snapshot->size() < keys.size()) return nullptr;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i] != snapshot->key(i)) return nullptr;
+  }
+  return snapshot;
+}
+
+bool ConfigSnapshot::Save(const std::string& path) const {
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.arena_size = this->header()->arena_size;
+  header.checksum = Checksum(arena_, header.arena_size);
+  header.reserved = 0;
+  // Write a new file and rename it over the old one, so the snapshot is
+  // never partially written, and a mapping of the old file is unaffected.
+  const std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (!file) return false;
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(arena_, 1, header.arena_size, file) ==
+                     header.arena_size;
+  written = fclose(file) == 0 && written;
+#if defined(_WIN32)
+  if (written) remove(path.c_str());
+#endif  // defined(_WIN32)
+  if (!written || rename(temp_path.c_str(), path.c_str()) != 0) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+ConfigHolder::ConfigHolder()
+    : snapshot_(ConfigSnapshot::Create(
+          std::vector<std::pair<std::string, ConfigValue>>())),
+      rcu_(snapshot_),
+      generation_(0) {}
+
+void ConfigHolder::Publish(std::shared_ptr<const ConfigSnapshot> snapshot) {
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+  std::atomic_store(&snapshot_, snapshot);
+  rcu_.Publish(std::move(snapshot));
+  generation_++;
+}
@@ -0,0 +1,229 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_CONFIG_SNAPSHOT_H_  // NOLINT
+#define FIREBASE_TESTAPP_CONFIG_SNAPSHOT_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rcu.h"  // NOLINT
+
+// Every representation of a config value, as returned by the remote_config
+// getters.
+struct ConfigValue {
+  ConfigValue() : boolean(false), long_value(0), double_value(0.0) {}
+
+  bool boolean;
+  int64_t long_value;
+  double double_value;
+  std::string string_value;
+  std::vector<unsigned char> data;
+};
+
+// Non-owning reference to a config value's data.
+struct DataView {
+  DataView() : data(nullptr), size(0) {}
+  DataView(const unsigned char* bytes, size_t length)
+      : data(bytes), size(length) {}
+
+  bool empty() const { return size == 0; }
+  const unsigned char* begin() const { return data; }
+  const unsigned char* end() const { return data + size; }
+  unsigned char operator[](size_t i) const { return data[i]; }
+
+  const unsigned char* data;
+  size_t size;
+};
+
+// Immutable copy of the active Remote Config values.
+//
+// remote_config::GetLong() and friends look up the key and parse the value
+// on every call.  A snapshot reads every value once, in all of its types,
+// and stores them in a single arena allocation, so reading a value is an
+// array index.  Keys passed when the snapshot is created have the same index
+// in every snapshot, so the app can look up their indices once and use them
+// with any later snapshot.
+//
+// Data values are copied into the arena once, when the snapshot is created,
+// and read through a DataView that points into it, so unlike
+// remote_config::GetData() reading data doesn't copy or allocate.  Each data
+// value starts at a multiple of kDataAlignment bytes, so data holding an
+// array of integers or doubles, such as a tuning table, can be read in place.
+//
+// The arena only contains offsets, so it's also the snapshot's file format:
+// Save() writes it after a short header with a version and checksum, and
+// Load() maps the file and reads values directly from the mapping.
+//
+// A snapshot never changes once created, so it can be read from any thread
+// without locking.
+class ConfigSnapshot {
+ public:
+  // Returned by Find() for keys that aren't in the snapshot.
+  static const size_t kNotFound = static_cast<size_t>(-1);
+  // Alignment of each data value.
+  static const size_t kDataAlignment = 8;
+
+  // Create a snapshot of values.  Key values[i].first has index i.
+  static std::shared_ptr<const ConfigSnapshot> Create(
+      const std::vector<std::pair<std::string, ConfigValue>>& values);
+  // Create a snapshot of the values currently active in Remote Config.  keys
+  // have indices 0 to keys.size() - 1, in order, followed by any other keys
+  // Remote Config has values for.
+  static std::shared_ptr<const ConfigSnapshot> FromRemoteConfig(
+      const std::vector<std::string>& keys);
+
+  // Map a snapshot written by Save(), returning null if the file is missing
+  // or invalid, or its first keys don't match keys, e.g. because it was
+  // written by a version of the app with different keys.  Values are read
+  // from the mapping, so this is fast enough to call before Remote Config
+  // is initialized.
+  static std::shared_ptr<const ConfigSnapshot> Load(
+      const std::string& path, const std::vector<std::string>& keys);
+  // Write the snapshot to the file at path, replacing it atomically.
+  bool Save(const std::string& path) const;
+
+  // Number of keys in the snapshot.
+  size_t size() const { return header()->num_entries; }
+  // Index of key, or kNotFound.
+  size_t Find(const char* key) const;
+  // Name of the key with index.
+  const char* key(size_t index) const;
+
+  // Values of the key with index.  Indices that aren't in the snapshot read
+  // as false, zero or empty.
+  bool GetBoolean(size_t index) const {
+    return index < size() && entries()[index].boolean;
+  }
+  int64_t GetLong(size_t index) const {
+    return index < size() ? entries()[index].long_value : 0;
+  }
+  double GetDouble(size_t index) const {
+    return index < size() ? entries()[index].double_value : 0.0;
+  }
+  // Null terminated string value.
+  const char* GetString(size_t index) const;
+  size_t GetStringSize(size_t index) const {
+    return index < size() ? entries()[index].string_value.size : 0;
+  }
+  // Data value, valid for the lifetime of the snapshot.
+  DataView GetData(size_t index) const;
+
+ private:
+  // Bytes in the arena, as an offset from the start of the arena.
+  struct Span {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  struct Entry {
+    Span key;
+    Span string_value;
+    Span data;
+    int64_t long_value;
+    double double_value;
+    uint32_t boolean;
+    uint32_t reserved;
+  };
+
+  // Start of the arena, followed by num_entries Entry structures, the index
+  // of each entry in ascending key order, then the data, keys and strings.
+  struct Header {
+    uint32_t arena_size;
+    uint32_t num_entries;
+  };
+
+  // storage owns the memory holding the arena.
+  ConfigSnapshot(std::shared_ptr<const void> storage, const char* arena)
+      : storage_(std::move(storage)), arena_(arena) {}
+
+  // Returns true if size bytes at arena are a valid arena.
+  static bool Validate(const char* arena, size_t size);
+
+  const Header* header() const {
+    return reinterpret_cast<const Header*>(arena_);
+  }
+  const Entry* entries() const {
+    return reinterpret_cast<const Entry*>(arena_ + sizeof(Header));
+  }
+  const uint32_t* sorted() const {
+    return reinterpret_cast<const uint32_t*>(entries() + size());
+  }
+
+  std::shared_ptr<const void> storage_;
+  const char* arena_;
+};
+
+// Holds the snapshot the app currently reads values from.
+//
+// When new values are activated a new snapshot is published, and readers
+// move to it the next time they read.  Readers holding the previous
+// snapshot can keep using it; it's freed once the last of them is done.
+//
+// Get() returns a reference to the current snapshot and can be called from
+// any thread.  Threads that read values frequently, such as a frame loop or
+// worker threads, should instead create a Reader once and read within a
+// ReadLock, which is wait-free and doesn't contend with other readers:
+//   ConfigHolder::Reader reader(&holder);
+//   ...
+//   ConfigHolder::ReadLock config(&reader);
+//   int64_t value = config->GetLong(index);
+//
+// All methods are thread safe.
+class ConfigHolder {
+ public:
+  typedef Rcu<ConfigSnapshot>::ReadLock ReadLock;
+
+  // A thread's registration with the holder, which must be destroyed before
+  // the holder.
+  class Reader : public Rcu<ConfigSnapshot>::Reader {
+   public:
+    explicit Reader(ConfigHolder* holder)
+        : Rcu<ConfigSnapshot>::Reader(&holder->rcu_) {}
+  };
+
+  // Starts with an empty snapshot.
+  ConfigHolder();
+
+  std::shared_ptr<const ConfigSnapshot> Get() const {
+    return std::atomic_load(&snapshot_);
+  }
+  // Replace the current snapshot.  Concurrent calls are serialized, so Get()
+  // and ReadLock always agree on the latest snapshot.
+  void Publish(std::shared_ptr<const ConfigSnapshot> snapshot);
+
+  // Free previous snapshots that readers have finished with.  They're also
+  // freed by later calls to Publish().
+  void Reclaim() { rcu_.Reclaim(); }
+
+  // Number of snapshots published.
+  uint64_t generation() const { return generation_.load(); }
+
+ private:
+  // Accessed with std::atomic_load() and std::atomic_store().
+  std::shared_ptr<const ConfigSnapshot> snapshot_;
+  Rcu<ConfigSnapshot> rcu_;
+  // Held while publishing, so snapshot_ and rcu_ are updated together.
+  std::mutex publish_mutex_;
+  std::atomic<uint64_t> generation_;
+};
+
+#endif  // FIREBASE_TESTAPP_CONFIG_SNAPSHOT_H_  // NOLINT
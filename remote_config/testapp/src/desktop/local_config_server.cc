@@ -0,0 +1,246 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "desktop/local_config_server.h"  // NOLINT
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+
+namespace {
+
+int64_t NowMilliseconds() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t WallClockMilliseconds() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Whether value reads as true, using the same rules as Remote Config.
+bool ParseBoolean(const std::string& value) {
+  static const char* kTrue[] = {"1", "true", "t", "yes", "y", "on"};
+  std::string lower(value);
+  for (size_t i = 0; i < lower.size(); ++i) {
+    lower[i] =
+        static_cast<char>(tolower(static_cast<unsigned char>(lower[i])));
+  }
+  for (size_t i = 0; i < sizeof(kTrue) / sizeof(kTrue[0]); ++i) {
+    if (lower == kTrue[i]) return true;
+  }
+  return false;
+}
+
+// Every representation of value, as the remote_config getters return it.
+ConfigValue ParseValue(const std::string& value) {
+  ConfigValue parsed;
+  parsed.boolean = ParseBoolean(value);
+  parsed.long_value = strtoll(value.c_str(), nullptr, 10);
+  parsed.double_value = strtod(value.c_str(), nullptr);
+  parsed.string_value = value;
+  parsed.data.assign(value.begin(), value.end());
+  return parsed;
+}
+
+// Remove leading and trailing whitespace.
+std::string Trim(const std::string& s) {
+  const size_t begin = s.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) return std::string();
+  return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+}  // namespace
+
+LocalConfigServer::LocalConfigServer(const Options& options)
+    : options_(options),
+      random_(std::random_device()()),
+      pending_activation_(false),
+      last_fetch_ms_(-1),
+      stop_(false) {
+  worker_ = std::thread([this]() { Run(); });
+}
+
+LocalConfigServer::~LocalConfigServer() { Stop(); }
+
+void LocalConfigServer::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  if (worker_.joinable()) worker_.join();
+}
+
+bool LocalConfigServer::ParseTemplate(const std::string& text,
+                                      Template* values) {
+  values->clear();
+  size_t begin = 0;
+  while (begin < text.size()) {
+    size_t end = text.find('\n', begin);
+    if (end == std::string::npos) end = text.size();
+    const std::string line = Trim(text.substr(begin, end - begin));
+    begin = end + 1;
+    if (line.empty() || line[0] == '#') continue;
+    const size_t equals = line.find('=');
+    if (equals == std::string::npos) return false;
+    values->push_back(std::make_pair(Trim(line.substr(0, equals)),
+                                     Trim(line.substr(equals + 1))));
+  }
+  return true;
+}
+
+void LocalConfigServer::SetDefaults(const Template& defaults) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  defaults_.clear();
+  defaults_.insert(defaults.begin(), defaults.end());
+}
+
+void LocalConfigServer::SetTemplate(const Template& values) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  template_.clear();
+  template_.insert(values.begin(), values.end());
+}
+
+void LocalConfigServer::SetOptions(const Options& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_ = options;
+}
+
+void LocalConfigServer::Fetch(
+    uint64_t cache_expiration_s,
+    const FetchScheduler::CompletionCallback& complete) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int64_t now_ms = NowMilliseconds();
+    Request request;
+    request.cache_expiration_s = cache_expiration_s;
+    request.complete = complete;
+    int64_t due_ms = now_ms;
+    // Fetches served from the cache don't reach the server.
+    const bool cached =
+        last_fetch_ms_ >= 0 &&
+        now_ms - last_fetch_ms_ <
+            static_cast<int64_t>(cache_expiration_s) * 1000;
+    if (!cached) {
+      std::uniform_int_distribution<int> jitter(-options_.latency_jitter_ms,
+                                                options_.latency_jitter_ms);
+      due_ms += std::max(options_.latency_ms + jitter(random_), 0);
+    }
+    requests_.insert(std::make_pair(due_ms, request));
+  }
+  wake_.notify_all();
+}
+
+bool LocalConfigServer::ActivateFetched() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!pending_activation_) return false;
+  pending_activation_ = false;
+  active_ = fetched_;
+  return true;
+}
+
+std::shared_ptr<const ConfigSnapshot> LocalConfigServer::Snapshot(
+    const std::vector<std::string>& keys) const {
+  std::vector<std::pair<std::string, ConfigValue>> values;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::set<std::string> seen;
+    auto add = [this, &values, &seen](const std::string& key) {
+      if (!seen.insert(key).second) return;
+      std::map<std::string, std::string>::const_iterator it =
+          active_.find(key);
+      if (it == active_.end()) {
+        it = defaults_.find(key);
+        if (it == defaults_.end()) {
+          values.push_back(std::make_pair(key, ConfigValue()));
+          return;
+        }
+      }
+      values.push_back(std::make_pair(key, ParseValue(it->second)));
+    };
+    for (size_t i = 0; i < keys.size(); ++i) add(keys[i]);
+    for (auto it = active_.begin(); it != active_.end(); ++it) {
+      add(it->first);
+    }
+    for (auto it = defaults_.begin(); it != defaults_.end(); ++it) {
+      add(it->first);
+    }
+  }
+  return ConfigSnapshot::Create(values);
+}
+
+void LocalConfigServer::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    if (requests_.empty()) {
+      wake_.wait(lock);
+      continue;
+    }
+    const int64_t now_ms = NowMilliseconds();
+    // A request that arrives while waiting may be due sooner, so the wait
+    // starts over whenever the worker is woken.
+    const int64_t due_ms = requests_.begin()->first;
+    if (due_ms > now_ms) {
+      wake_.wait_for(lock, std::chrono::milliseconds(due_ms - now_ms));
+      continue;
+    }
+    Request request = requests_.begin()->second;
+    requests_.erase(requests_.begin());
+    FetchScheduler::FetchResult result = Respond(request);
+    // The callback may call back into the server.
+    lock.unlock();
+    request.complete(result);
+    lock.lock();
+  }
+}
+
+FetchScheduler::FetchResult LocalConfigServer::Respond(
+    const Request& request) {
+  FetchScheduler::FetchResult result;
+  const int64_t now_ms = NowMilliseconds();
+  if (last_fetch_ms_ >= 0 &&
+      now_ms - last_fetch_ms_ <
+          static_cast<int64_t>(request.cache_expiration_s) * 1000) {
+    result.success = true;
+    return result;
+  }
+  while (!window_.empty() &&
+         window_.front() <= now_ms - options_.throttle_window_ms) {
+    window_.pop_front();
+  }
+  if (!options_.developer_mode && !window_.empty() &&
+      static_cast<int>(window_.size()) >= options_.max_fetches_per_window) {
+    // Throttled until the oldest fetch leaves the window.
+    result.throttled = true;
+    result.throttled_end_time = static_cast<uint64_t>(
+        WallClockMilliseconds() + window_.front() +
+        options_.throttle_window_ms - now_ms);
+    return result;
+  }
+  window_.push_back(now_ms);
+  std::uniform_real_distribution<double> error(0.0, 1.0);
+  if (error(random_) < options_.error_rate) return result;
+  last_fetch_ms_ = now_ms;
+  fetched_ = template_;
+  pending_activation_ = true;
+  result.success = true;
+  return result;
+}
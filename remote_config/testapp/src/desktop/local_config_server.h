@@ -0,0 +1,139 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DESKTOP_LOCAL_CONFIG_SERVER_H_  // NOLINT
+#define FIREBASE_TESTAPP_DESKTOP_LOCAL_CONFIG_SERVER_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "config_snapshot.h"  // NOLINT
+#include "fetch_scheduler.h"  // NOLINT
+
+// In-process stand-in for the Remote Config backend, for exercising the
+// fetch path without the network.
+//
+// The server serves a template of values.  Fetch() completes on a worker
+// thread after an injected latency, and fails with a configurable error
+// rate.  Like the backend, it throttles apps that fetch too often unless
+// developer mode is set, and serves fetches younger than the cache
+// expiration from the cache.  Fetch() and ActivateFetched() match
+// FetchScheduler's FetchFunction and ActivateFunction, so the scheduler can
+// be driven by the server instead of Remote Config.
+//
+// All methods are thread safe.
+class LocalConfigServer {
+ public:
+  // Config values, as key and string value.
+  typedef std::vector<std::pair<std::string, std::string>> Template;
+
+  struct Options {
+    Options()
+        : latency_ms(50),
+          latency_jitter_ms(0),
+          error_rate(0.0),
+          max_fetches_per_window(5),
+          throttle_window_ms(60 * 60 * 1000),
+          developer_mode(false) {}
+
+    // Time each fetch from the server takes, varied randomly by up to
+    // latency_jitter_ms either way.
+    int latency_ms;
+    int latency_jitter_ms;
+    // Fraction of fetches from the server that fail, from 0 to 1.
+    double error_rate;
+    // Fetches from the server allowed in any throttle window before further
+    // fetches are throttled.
+    int max_fetches_per_window;
+    int64_t throttle_window_ms;
+    // Disables throttling, as kConfigSettingDeveloperMode does.
+    bool developer_mode;
+  };
+
+  explicit LocalConfigServer(const Options& options);
+  ~LocalConfigServer();
+
+  // Parse a template from lines of key=value.  Blank lines and lines
+  // starting with # are ignored.  Returns false if a line has no '='.
+  static bool ParseTemplate(const std::string& text, Template* values);
+
+  // Values of keys not in the template, as set with
+  // remote_config::SetDefaults().
+  void SetDefaults(const Template& defaults);
+  // Values served by subsequent fetches.
+  void SetTemplate(const Template& values);
+  // Change the injected latency, errors and throttling.
+  void SetOptions(const Options& options);
+
+  // Start a fetch, calling complete on the worker thread when it finishes.
+  void Fetch(uint64_t cache_expiration_s,
+             const FetchScheduler::CompletionCallback& complete);
+  // Stop the worker thread, waiting for a completion callback that's
+  // running to return.  Fetches that haven't completed, and any started
+  // later, never complete.  Call before destroying anything the callbacks
+  // use, from the thread that owns the server, not from a callback.  The
+  // destructor calls it too.
+  void Stop();
+  // Activate the most recently fetched values, returning false if there
+  // were none.
+  bool ActivateFetched();
+
+  // Snapshot of the active values, with keys first, in order, followed by
+  // the other keys in the template or defaults.
+  std::shared_ptr<const ConfigSnapshot> Snapshot(
+      const std::vector<std::string>& keys) const;
+
+ private:
+  struct Request {
+    uint64_t cache_expiration_s;
+    FetchScheduler::CompletionCallback complete;
+  };
+
+  void Run();
+  // Returns the response to a request due now.  Must be called with mutex_
+  // held.
+  FetchScheduler::FetchResult Respond(const Request& request);
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  Options options_;
+  std::mt19937 random_;
+  std::map<std::string, std::string> defaults_;
+  std::map<std::string, std::string> template_;
+  std::map<std::string, std::string> fetched_;
+  std::map<std::string, std::string> active_;
+  bool pending_activation_;
+  // Steady clock time of the last fetch served by the server, or -1.
+  int64_t last_fetch_ms_;
+  // Steady clock times of fetches in the current throttle window.
+  std::deque<int64_t> window_;
+  // Requests by the steady clock time their response is due.  Latency is
+  // random, so they're served in that order rather than the order they
+  // arrived.
+  std::multimap<int64_t, Request> requests_;
+  bool stop_;
+  std::thread worker_;
+};
+
+#endif  // FIREBASE_TESTAPP_DESKTOP_LOCAL_CONFIG_SERVER_H_  // NOLINT
@@ -0,0 +1,484 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "desktop/remote_config_benchmark.h"  // NOLINT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "firebase/remote_config.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+#include "config_snapshot.h"  // NOLINT
+#include "desktop/allocation_counter.h"  // NOLINT
+#include "desktop/local_config_server.h"  // NOLINT
+#include "fetch_scheduler.h"  // NOLINT
+
+namespace {
+
+// Returns the value of --name=value from the command line or nullptr.
+const char* GetOption(int argc, const char* argv[], const char* name) {
+  const size_t length = strlen(name);
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], name, length) == 0 && argv[i][length] == '=') {
+      return argv[i] + length + 1;
+    }
+  }
+  return nullptr;
+}
+
+bool HasFlag(int argc, const char* argv[], const char* name) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], name) == 0) return true;
+  }
+  return false;
+}
+
+int GetIntOption(int argc, const char* argv[], const char* name,
+                 int default_value) {
+  const char* value = GetOption(argc, argv, name);
+  return value ? atoi(value) : default_value;
+}
+
+int64_t NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Compare reading a data value with remote_config::GetData(), which copies
+// it into a new vector on each call, against reading it from a snapshot.
+// Each read touches the first and last byte, as a reader of the value would.
+int RunGetDataBenchmark(int reads) {
+  namespace remote_config = ::firebase::remote_config;
+  const char kKey[] = "BenchmarkData";
+  const std::vector<std::string> keys(1, kKey);
+  LogMessage("Benchmark: %d reads of each data value", reads);
+  for (size_t size = 64; size <= 256 * 1024; size *= 16) {
+    const std::string value(size, 'x');
+    const remote_config::ConfigKeyValue defaults[] = {{kKey, value.c_str()}};
+    remote_config::SetDefaults(defaults, 1);
+
+    uint64_t checksum = 0;
+    uint64_t allocations = AllocationCount();
+    int64_t start = NowNanoseconds();
+    for (int i = 0; i < reads; ++i) {
+      std::vector<unsigned char> data = remote_config::GetData(kKey);
+      checksum += data.front() + data.back();
+    }
+    const int64_t get_data_ns = NowNanoseconds() - start;
+    const uint64_t get_data_allocations = AllocationCount() - allocations;
+
+    start = NowNanoseconds();
+    std::shared_ptr<const ConfigSnapshot> snapshot =
+        ConfigSnapshot::FromRemoteConfig(keys);
+    const int64_t create_ns = NowNanoseconds() - start;
+    const size_t index = snapshot->Find(kKey);
+    uint64_t snapshot_checksum = 0;
+    allocations = AllocationCount();
+    start = NowNanoseconds();
+    for (int i = 0; i < reads; ++i) {
+      DataView data = snapshot->GetData(index);
+      snapshot_checksum += data[0] + data[data.size - 1];
+    }
+    const int64_t snapshot_ns = NowNanoseconds() - start;
+    const uint64_t snapshot_allocations = AllocationCount() - allocations;
+    if (checksum != snapshot_checksum) {
+      LogMessage("Benchmark: snapshot data doesn't match GetData()");
+      return 1;
+    }
+    LogMessage("Benchmark: %6d bytes  GetData %9.1f ns/read "
+               "%.1f allocations/read  snapshot %5.1f ns/read "
+               "%.1f allocations/read, created in %.0f us",
+               static_cast<int>(size),
+               static_cast<double>(get_data_ns) / reads,
+               static_cast<double>(get_data_allocations) / reads,
+               static_cast<double>(snapshot_ns) / reads,
+               static_cast<double>(snapshot_allocations) / reads,
+               static_cast<double>(create_ns) / 1e3);
+  }
+  return 0;
+}
+
+enum ReadMethod {
+  // ConfigHolder::ReadLock.
+  kReadRcu,
+  // ConfigHolder::Get().
+  kReadShared,
+  // A snapshot guarded by a mutex.
+  kReadMutex,
+};
+
+// Read values from threads reading concurrently while the main thread
+// publishes a new snapshot every millisecond.  Returns reads per second.
+double MeasureReads(ReadMethod method, int threads, int duration_ms,
+                    const std::vector<std::shared_ptr<const ConfigSnapshot>>&
+                        snapshots) {
+  ConfigHolder holder;
+  holder.Publish(snapshots[0]);
+  std::mutex mutex;
+  std::shared_ptr<const ConfigSnapshot> locked = snapshots[0];
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> total_reads(0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < threads; ++t) {
+    readers.push_back(std::thread([&]() {
+      ConfigHolder::Reader reader(&holder);
+      uint64_t reads = 0;
+      int64_t sum = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        // Check for the end of the run every 256 reads.
+        for (int i = 0; i < 256; ++i) {
+          const size_t index = static_cast<size_t>(i) & 63;
+          if (method == kReadRcu) {
+            ConfigHolder::ReadLock config(&reader);
+            sum += config->GetLong(index);
+          } else if (method == kReadShared) {
+            sum += holder.Get()->GetLong(index);
+          } else {
+            std::lock_guard<std::mutex> lock(mutex);
+            sum += locked->GetLong(index);
+          }
+        }
+        reads += 256;
+      }
+      // Use the sum so the reads aren't optimized away.
+      total_reads += reads + (sum == 42 ? 1 : 0);
+    }));
+  }
+  const int64_t start = NowNanoseconds();
+  for (int i = 0; NowNanoseconds() - start < duration_ms * 1000000LL; ++i) {
+    const std::shared_ptr<const ConfigSnapshot>& snapshot =
+        snapshots[static_cast<size_t>(i) % snapshots.size()];
+    holder.Publish(snapshot);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      locked = snapshot;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  stop = true;
+  for (size_t t = 0; t < readers.size(); ++t) readers[t].join();
+  const double elapsed_s =
+      static_cast<double>(NowNanoseconds() - start) / 1e9;
+  return static_cast<double>(total_reads.load()) / elapsed_s;
+}
+
+// Compare how reads scale with the number of reading threads for a
+// ConfigHolder::ReadLock, ConfigHolder::Get() and a mutex.
+int RunReaderBenchmark(int max_threads, int duration_ms) {
+  // Snapshots of 64 values, alternately published.
+  std::vector<std::shared_ptr<const ConfigSnapshot>> snapshots;
+  for (int s = 0; s < 2; ++s) {
+    std::vector<std::pair<std::string, ConfigValue>> values(64);
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i].first = "key" + std::to_string(i);
+      values[i].second.long_value = static_cast<int64_t>(i) + s;
+    }
+    snapshots.push_back(ConfigSnapshot::Create(values));
+  }
+  LogMessage("Benchmark: reads/sec with up to %d threads over %dms, "
+             "publishing a snapshot every 1ms (%d cores)",
+             max_threads, duration_ms,
+             static_cast<int>(std::thread::hardware_concurrency()));
+  const char* kNames[] = {"ReadLock", "Get()", "mutex"};
+  const ReadMethod kMethods[] = {kReadRcu, kReadShared, kReadMutex};
+  for (size_t m = 0; m < sizeof(kMethods) / sizeof(kMethods[0]); ++m) {
+    // Powers of two up to max_threads, then max_threads.
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+      thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+    double single = 0.0;
+    for (size_t t = 0; t < thread_counts.size(); ++t) {
+      const int threads = thread_counts[t];
+      const double reads =
+          MeasureReads(kMethods[m], threads, duration_ms, snapshots);
+      if (t == 0) single = reads;
+      LogMessage("Benchmark: %-8s %3d threads  %12.0f reads/sec  "
+                 "%5.1f ns/read/thread  scaling %.2fx",
+                 kNames[m], threads, reads, threads * 1e9 / reads,
+                 reads / single);
+    }
+  }
+  return 0;
+}
+
+// Value at percentile (0 to 100) of samples, which must be sorted.
+int64_t Percentile(const std::vector<int64_t>& samples, double percentile) {
+  if (samples.empty()) return 0;
+  const size_t index = static_cast<size_t>(
+      percentile / 100.0 * static_cast<double>(samples.size() - 1));
+  return samples[index];
+}
+
+void LogLatency(const char* label, std::vector<int64_t>* samples_ns,
+                double scale, const char* unit) {
+  if (samples_ns->empty()) {
+    LogMessage("Benchmark: %-22s no samples", label);
+    return;
+  }
+  std::sort(samples_ns->begin(), samples_ns->end());
+  LogMessage("Benchmark: %-22s p50 %8.1f%s  p99 %8.1f%s  max %8.1f%s", label,
+             static_cast<double>(Percentile(*samples_ns, 50)) / scale, unit,
+             static_cast<double>(Percentile(*samples_ns, 99)) / scale, unit,
+             static_cast<double>(Percentile(*samples_ns, 100)) / scale, unit);
+}
+
+bool ReadFile(const char* path, std::string* contents) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents->append(buffer, read);
+  }
+  fclose(file);
+  return true;
+}
+
+struct FetchBenchmarkOptions {
+  int fetches;
+  int keys;
+  int latency_ms;
+  int error_percent;
+  int threads;
+  int duration_ms;
+  // Template served while running the FetchScheduler, or empty.
+  LocalConfigServer::Template values;
+};
+
+// Fetch from a LocalConfigServer and apply each fetch as the app does, by
+// activating it and publishing a new snapshot, while threads read the
+// current snapshot.  Reports the latency of fetches and of applying them,
+// and of reads while idle and while a fetch is being applied.
+void MeasureFetchAndApply(const FetchBenchmarkOptions& options) {
+  LocalConfigServer::Options server_options;
+  server_options.latency_ms = options.latency_ms;
+  server_options.latency_jitter_ms = options.latency_ms / 5;
+  server_options.error_rate = options.error_percent / 100.0;
+  server_options.developer_mode = true;
+  LocalConfigServer server(server_options);
+  std::vector<std::string> keys;
+  LocalConfigServer::Template defaults;
+  for (int k = 0; k < options.keys; ++k) {
+    keys.push_back("key" + std::to_string(k));
+    defaults.push_back(std::make_pair(keys.back(), "0"));
+  }
+  server.SetDefaults(defaults);
+  ConfigHolder holder;
+  holder.Publish(server.Snapshot(keys));
+
+  // Each reader times batches of reads, sorted by whether a fetch was being
+  // applied when the batch started or finished.
+  const int kBatch = 64;
+  const size_t kMaxSamples = 1 << 20;
+  std::atomic<bool> applying(false);
+  std::atomic<bool> stop(false);
+  std::vector<std::vector<int64_t>> idle_reads(options.threads);
+  std::vector<std::vector<int64_t>> apply_reads(options.threads);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < options.threads; ++t) {
+    readers.push_back(std::thread([&, t]() {
+      ConfigHolder::Reader reader(&holder);
+      int64_t sum = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        const bool applying_before = applying.load();
+        const int64_t start = NowNanoseconds();
+        {
+          ConfigHolder::ReadLock config(&reader);
+          const size_t size = config->size();
+          for (int i = 0; i < kBatch; ++i) {
+            sum += config->GetLong(static_cast<size_t>(i) % size);
+          }
+        }
+        const int64_t elapsed = NowNanoseconds() - start;
+        std::vector<int64_t>& samples = applying_before || applying.load()
+                                            ? apply_reads[t]
+                                            : idle_reads[t];
+        if (samples.size() < kMaxSamples) samples.push_back(elapsed);
+      }
+      if (sum == 42) LogMessage("Benchmark: unlikely sum");
+    }));
+  }
+
+  std::vector<int64_t> fetch_ns;
+  std::vector<int64_t> activate_ns;
+  std::vector<int64_t> publish_ns;
+  int failures = 0;
+  for (int f = 0; f < options.fetches; ++f) {
+    LocalConfigServer::Template values;
+    for (int k = 0; k < options.keys; ++k) {
+      values.push_back(std::make_pair(keys[k], std::to_string(f + k)));
+    }
+    server.SetTemplate(values);
+    std::promise<FetchScheduler::FetchResult> done;
+    int64_t start = NowNanoseconds();
+    server.Fetch(0, [&done](const FetchScheduler::FetchResult& result) {
+      done.set_value(result);
+    });
+    if (!done.get_future().get().success) {
+      failures++;
+      continue;
+    }
+    fetch_ns.push_back(NowNanoseconds() - start);
+
+    applying = true;
+    start = NowNanoseconds();
+    server.ActivateFetched();
+    std::shared_ptr<const ConfigSnapshot> snapshot = server.Snapshot(keys);
+    const int64_t activated = NowNanoseconds();
+    holder.Publish(std::move(snapshot));
+    const int64_t published = NowNanoseconds();
+    applying = false;
+    activate_ns.push_back(activated - start);
+    publish_ns.push_back(published - activated);
+  }
+  stop = true;
+  for (size_t t = 0; t < readers.size(); ++t) readers[t].join();
+
+  std::vector<int64_t> idle;
+  std::vector<int64_t> apply;
+  for (int t = 0; t < options.threads; ++t) {
+    idle.insert(idle.end(), idle_reads[t].begin(), idle_reads[t].end());
+    apply.insert(apply.end(), apply_reads[t].begin(), apply_reads[t].end());
+  }
+  LogMessage("Benchmark: %d fetches of %d keys, %dms latency, %d failed, "
+             "%d reading threads",
+             options.fetches, options.keys, options.latency_ms, failures,
+             options.threads);
+  LogLatency("fetch", &fetch_ns, 1e6, "ms");
+  LogLatency("activate + snapshot", &activate_ns, 1e3, "us");
+  LogLatency("publish", &publish_ns, 1e3, "us");
+  LogLatency("read, idle", &idle, kBatch, "ns");
+  LogLatency("read, while applying", &apply, kBatch, "ns");
+}
+
+// Drive a FetchScheduler from a LocalConfigServer that throttles after 3
+// fetches a second, fetching every 100ms, and log the scheduler's metrics.
+void RunScheduledFetches(const FetchBenchmarkOptions& options) {
+  LocalConfigServer::Options server_options;
+  server_options.latency_ms = options.latency_ms;
+  server_options.error_rate = options.error_percent / 100.0;
+  server_options.max_fetches_per_window = 3;
+  server_options.throttle_window_ms = 1000;
+  LocalConfigServer server(server_options);
+  server.SetTemplate(options.values);
+  ConfigHolder holder;
+
+  FetchScheduler::Options scheduler_options;
+  scheduler_options.interval_ms = 100;
+  scheduler_options.initial_delay_ms = 0;
+  scheduler_options.cache_expiration_s = 0;
+  scheduler_options.initial_backoff_ms = 50;
+  scheduler_options.max_backoff_ms = 400;
+  FetchScheduler scheduler(
+      [&server](uint64_t cache_expiration_s,
+                const FetchScheduler::CompletionCallback& complete) {
+        server.Fetch(cache_expiration_s, complete);
+      },
+      [&server]() { return server.ActivateFetched(); }, scheduler_options);
+  scheduler.Subscribe([&server, &holder]() {
+    holder.Publish(server.Snapshot(std::vector<std::string>()));
+  });
+  LogMessage("Benchmark: scheduled fetches for %dms, throttled after 3 "
+             "fetches a second",
+             options.duration_ms);
+  scheduler.Start();
+  const int64_t start = NowNanoseconds();
+  while (NowNanoseconds() - start < options.duration_ms * 1000000LL) {
+    scheduler.Update();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  // The server's worker calls back into the scheduler, so it's stopped
+  // before the scheduler is destroyed.
+  server.Stop();
+  scheduler.LogMetrics();
+  LogMessage("Benchmark: %d keys active",
+             static_cast<int>(holder.Get()->size()));
+}
+
+}  // namespace
+
+bool RemoteConfigBenchmarkRequested(int argc, const char* argv[]) {
+  return HasFlag(argc, argv, "--benchmark");
+}
+
+int RunRemoteConfigBenchmark(int argc, const char* argv[]) {
+  const int reads = GetIntOption(argc, argv, "--reads", 10000);
+  if (reads <= 0) {
+    LogMessage("Benchmark: --reads must be positive");
+    return 1;
+  }
+  if (HasFlag(argc, argv, "--get_data")) return RunGetDataBenchmark(reads);
+  if (HasFlag(argc, argv, "--readers")) {
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    const int threads =
+        GetIntOption(argc, argv, "--threads", cores > 0 ? cores : 4);
+    const int duration_ms = GetIntOption(argc, argv, "--duration_ms", 500);
+    if (threads <= 0 || duration_ms <= 0) {
+      LogMessage("Benchmark: --threads and --duration_ms must be positive");
+      return 1;
+    }
+    return RunReaderBenchmark(threads, duration_ms);
+  }
+  if (HasFlag(argc, argv, "--fetch")) {
+    FetchBenchmarkOptions options;
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    options.fetches = GetIntOption(argc, argv, "--fetches", 20);
+    options.keys = GetIntOption(argc, argv, "--keys", 1000);
+    options.latency_ms = GetIntOption(argc, argv, "--latency_ms", 50);
+    options.error_percent = GetIntOption(argc, argv, "--error_percent", 0);
+    options.threads =
+        GetIntOption(argc, argv, "--threads", cores > 0 ? cores : 4);
+    options.duration_ms = GetIntOption(argc, argv, "--duration_ms", 3000);
+    if (options.fetches <= 0 || options.keys <= 0 || options.threads <= 0 ||
+        options.latency_ms < 0 || options.error_percent < 0 ||
+        options.error_percent > 100 || options.duration_ms <= 0) {
+      LogMessage("Benchmark: invalid --fetch options");
+      return 1;
+    }
+    const char* template_path = GetOption(argc, argv, "--template");
+    if (template_path) {
+      std::string text;
+      if (!ReadFile(template_path, &text) ||
+          !LocalConfigServer::ParseTemplate(text, &options.values)) {
+        LogMessage("Benchmark: can't read template %s", template_path);
+        return 1;
+      }
+    } else {
+      options.values.push_back(std::make_pair("TestLong", "43"));
+      options.values.push_back(std::make_pair("TestString", "Hello Local"));
+    }
+    MeasureFetchAndApply(options);
+    RunScheduledFetches(options);
+    return 0;
+  }
+  LogMessage("Benchmark: specify a benchmark, e.g. --get_data, --readers or "
+             "--fetch");
+  return 1;
+}
@@ -0,0 +1,51 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DESKTOP_REMOTE_CONFIG_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_DESKTOP_REMOTE_CONFIG_BENCHMARK_H_  // NOLINT
+
+// Returns true if the command line asks for a benchmark to be run instead of
+// the sample, i.e. contains --benchmark.
+bool RemoteConfigBenchmarkRequested(int argc, const char* argv[]);
+
+// Run the benchmark selected on the command line.  Remote Config must be
+// initialized.  The benchmarks replace the app's defaults.
+//
+// Options:
+//   --get_data       Compare reading data values of 64 bytes to 256KB with
+//                    remote_config::GetData() against a ConfigSnapshot.
+//   --reads=N        Number of reads of each value (default 10000).
+//   --readers        Compare how reads from 1 to N threads scale for
+//                    ConfigHolder::ReadLock, ConfigHolder::Get() and a
+//                    mutex, while a new snapshot is published every
+//                    millisecond.
+//   --threads=N      Maximum number of reading threads with --readers
+//                    (default the number of cores).
+//   --duration_ms=N  Duration of each --readers run (default 500), or of
+//                    the scheduled fetches with --fetch (default 3000).
+//   --fetch          Fetch from a LocalConfigServer and measure the latency
+//                    of fetches, of activating and publishing them, and of
+//                    reads from --threads threads while idle and while a
+//                    fetch is applied.  Then drive a FetchScheduler from a
+//                    server that throttles after 3 fetches a second.
+//   --fetches=N      Number of fetches measured with --fetch (default 20).
+//   --keys=N         Number of keys in each fetch (default 1000).
+//   --latency_ms=N   Latency of each fetch from the server (default 50).
+//   --error_percent=N  Percentage of fetches that fail (default 0).
+//   --template=FILE  key=value lines served to the FetchScheduler.
+//
+// Returns 0 on success, non-zero if the options are invalid.
+int RunRemoteConfigBenchmark(int argc, const char* argv[]);
+
+#endif  // FIREBASE_TESTAPP_DESKTOP_REMOTE_CONFIG_BENCHMARK_H_  // NOLINT
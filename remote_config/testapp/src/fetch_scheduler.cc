@@ -0,0 +1,207 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fetch_scheduler.h"  // NOLINT
+
+#include <algorithm>
+#include <chrono>
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+namespace {
+
+int64_t NowMilliseconds() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Milliseconds since the epoch, the clock throttled_end_time is based on.
+int64_t WallClockMilliseconds() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+FetchScheduler::FetchScheduler(const FetchFunction& fetch,
+                               const ActivateFunction& activate,
+                               const Options& options)
+    : fetch_(fetch),
+      activate_(activate),
+      options_(options),
+      random_(std::random_device()()),
+      in_flight_(false),
+      fetched_(false),
+      consecutive_failures_(0),
+      next_fetch_ms_(0),
+      throttled_until_ms_(0),
+      fetch_start_ms_(0),
+      last_success_ms_(-1) {
+  metrics_.fetches = 0;
+  metrics_.successes = 0;
+  metrics_.failures = 0;
+  metrics_.throttled = 0;
+  metrics_.activations = 0;
+  metrics_.last_fetch_latency_ms = 0;
+  metrics_.max_fetch_latency_ms = 0;
+}
+
+void FetchScheduler::Subscribe(const Subscriber& subscriber) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  subscribers_.push_back(subscriber);
+}
+
+void FetchScheduler::Start() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uniform_int_distribution<int64_t> delay(
+        0, std::max<int64_t>(options_.initial_delay_ms, 0));
+    next_fetch_ms_ = NowMilliseconds() + delay(random_);
+    // The SDK keeps values fetched while the app last ran until they're
+    // activated.
+    if (options_.policy == kActivateOnNextLaunch) fetched_ = true;
+  }
+  if (options_.policy == kActivateOnNextLaunch) Activate();
+}
+
+bool FetchScheduler::Update() {
+  bool start = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int64_t now_ms = NowMilliseconds();
+    if (!in_flight_ && next_fetch_ms_ <= now_ms &&
+        throttled_until_ms_ <= now_ms) {
+      in_flight_ = true;
+      fetch_start_ms_ = now_ms;
+      metrics_.fetches++;
+      start = true;
+    }
+  }
+  if (start) {
+    fetch_(options_.cache_expiration_s,
+           [this](const FetchResult& result) { OnComplete(result); });
+  }
+  return options_.policy == kActivateImmediately && Activate();
+}
+
+bool FetchScheduler::SafePoint() {
+  return options_.policy == kActivateAtSafePoint && Activate();
+}
+
+void FetchScheduler::FetchSoon() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  next_fetch_ms_ = 0;
+}
+
+void FetchScheduler::OnComplete(const FetchResult& result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int64_t now_ms = NowMilliseconds();
+  const int64_t latency_ms = now_ms - fetch_start_ms_;
+  in_flight_ = false;
+  metrics_.last_fetch_latency_ms = latency_ms;
+  metrics_.max_fetch_latency_ms =
+      std::max(metrics_.max_fetch_latency_ms, latency_ms);
+  if (result.success) {
+    metrics_.successes++;
+    consecutive_failures_ = 0;
+    last_success_ms_ = now_ms;
+    // Values fetched under kActivateOnNextLaunch are left for Start() to
+    // activate next time the app runs.
+    fetched_ = options_.policy != kActivateOnNextLaunch;
+    next_fetch_ms_ = now_ms + Jitter(options_.interval_ms);
+    return;
+  }
+  metrics_.failures++;
+  consecutive_failures_++;
+  int64_t backoff_ms = options_.initial_backoff_ms;
+  for (int i = 1;
+       i < consecutive_failures_ && backoff_ms < options_.max_backoff_ms; ++i) {
+    backoff_ms *= 2;
+  }
+  backoff_ms = std::min(backoff_ms, options_.max_backoff_ms);
+  next_fetch_ms_ = now_ms + Jitter(backoff_ms);
+  if (result.throttled) {
+    metrics_.throttled++;
+    // Convert the end of the throttle to the scheduler's clock, and spread
+    // out the fetches of apps throttled until the same time.
+    const int64_t remaining_ms =
+        static_cast<int64_t>(result.throttled_end_time) -
+        WallClockMilliseconds();
+    if (remaining_ms > 0) {
+      std::uniform_real_distribution<double> spread(0.0, options_.jitter);
+      throttled_until_ms_ =
+          now_ms + remaining_ms +
+          static_cast<int64_t>(static_cast<double>(remaining_ms) *
+                               spread(random_));
+    }
+  }
+}
+
+bool FetchScheduler::Activate() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fetched_) return false;
+    fetched_ = false;
+  }
+  if (!activate_()) return false;
+  std::vector<Subscriber> subscribers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    metrics_.activations++;
+    subscribers = subscribers_;
+  }
+  for (size_t i = 0; i < subscribers.size(); ++i) subscribers[i]();
+  return true;
+}
+
+int64_t FetchScheduler::Jitter(int64_t delay_ms) {
+  std::uniform_real_distribution<double> factor(1.0 - options_.jitter,
+                                                1.0 + options_.jitter);
+  return static_cast<int64_t>(static_cast<double>(delay_ms) *
+                              factor(random_));
+}
+
+FetchScheduler::Metrics FetchScheduler::GetMetrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int64_t now_ms = NowMilliseconds();
+  Metrics metrics = metrics_;
+  metrics.staleness_ms =
+      last_success_ms_ < 0 ? -1 : now_ms - last_success_ms_;
+  metrics.next_fetch_ms =
+      in_flight_ ? 0
+                 : std::max<int64_t>(
+                       std::max(next_fetch_ms_, throttled_until_ms_) - now_ms,
+                       0);
+  metrics.pending_activation = fetched_;
+  return metrics;
+}
+
+void FetchScheduler::LogMetrics() const {
+  Metrics metrics = GetMetrics();
+  LogMessage(
+      "FetchScheduler: fetches=%d successes=%d failures=%d throttled=%d "
+      "activations=%d latency=%dms max_latency=%dms staleness=%dms "
+      "next_fetch=%dms%s",
+      static_cast<int>(metrics.fetches), static_cast<int>(metrics.successes),
+      static_cast<int>(metrics.failures), static_cast<int>(metrics.throttled),
+      static_cast<int>(metrics.activations),
+      static_cast<int>(metrics.last_fetch_latency_ms),
+      static_cast<int>(metrics.max_fetch_latency_ms),
+      static_cast<int>(metrics.staleness_ms),
+      static_cast<int>(metrics.next_fetch_ms),
+      metrics.pending_activation ? " pending_activation" : "");
+}
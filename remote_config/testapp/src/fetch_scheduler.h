@@ -0,0 +1,171 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_FETCH_SCHEDULER_H_  // NOLINT
+#define FIREBASE_TESTAPP_FETCH_SCHEDULER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// Fetches config values periodically in the background and activates them
+// according to a policy.
+//
+// Update() is called from the app's main loop.  It starts a fetch when one
+// is due and returns without waiting for it to complete.  Fetches are
+// spaced by an interval with random jitter, and the first fetch after the
+// app starts is delayed by a random amount, so a fleet of apps that start
+// together don't all fetch at once.  After a failure the scheduler backs
+// off exponentially, and after a throttled fetch it waits until the
+// throttle ends.
+//
+// Fetched values are activated on the thread that calls Update(),
+// SafePoint() or Start(), never on the thread a fetch completes on, and
+// subscribers are notified after each activation.
+//
+// All methods are thread safe.
+class FetchScheduler {
+ public:
+  enum ActivationPolicy {
+    // Activate fetched values on the next call to Update().
+    kActivateImmediately,
+    // Activate values fetched while the app was last running when Start()
+    // is called, so values never change while the app runs.
+    kActivateOnNextLaunch,
+    // Activate fetched values when the app calls SafePoint().
+    kActivateAtSafePoint,
+  };
+
+  struct FetchResult {
+    FetchResult() : success(false), throttled(false), throttled_end_time(0) {}
+
+    bool success;
+    // Whether the fetch failed because the app is fetching too often.
+    bool throttled;
+    // When the throttle ends, in milliseconds since the epoch.
+    uint64_t throttled_end_time;
+  };
+
+  // Called with the result of a fetch, from any thread.
+  typedef std::function<void(const FetchResult& result)> CompletionCallback;
+  // Start a fetch of values older than cache_expiration_s, calling complete
+  // when it finishes.  complete may be called before this returns.
+  typedef std::function<void(uint64_t cache_expiration_s,
+                             const CompletionCallback& complete)>
+      FetchFunction;
+  // Activate the most recently fetched values, returning false if there
+  // were none.
+  typedef std::function<bool()> ActivateFunction;
+  // Called after fetched values are activated.
+  typedef std::function<void()> Subscriber;
+
+  struct Options {
+    Options()
+        : interval_ms(12 * 60 * 60 * 1000),
+          jitter(0.1),
+          initial_delay_ms(30 * 1000),
+          cache_expiration_s(12 * 60 * 60),
+          initial_backoff_ms(60 * 1000),
+          max_backoff_ms(60 * 60 * 1000),
+          policy(kActivateImmediately) {}
+
+    // Time between successful fetches.
+    int64_t interval_ms;
+    // Each delay is randomly varied by up to this fraction, e.g. 0.1 for
+    // +/- 10%.
+    double jitter;
+    // The first fetch is made after a random delay of up to this long.
+    int64_t initial_delay_ms;
+    // Passed to each fetch; values fetched more recently than this are
+    // served from the cache rather than the server.
+    uint64_t cache_expiration_s;
+    // Delay before retrying a failed fetch, doubled after each subsequent
+    // failure up to max_backoff_ms.
+    int64_t initial_backoff_ms;
+    int64_t max_backoff_ms;
+    ActivationPolicy policy;
+  };
+
+  struct Metrics {
+    uint64_t fetches;
+    uint64_t successes;
+    uint64_t failures;
+    uint64_t throttled;
+    uint64_t activations;
+    // Duration of the most recent and longest fetches.
+    int64_t last_fetch_latency_ms;
+    int64_t max_fetch_latency_ms;
+    // Time since the last successful fetch, or -1 if there hasn't been one.
+    int64_t staleness_ms;
+    // Time until the next fetch is due, or 0 if one is in flight.
+    int64_t next_fetch_ms;
+    // Whether fetched values are waiting to be activated.
+    bool pending_activation;
+  };
+
+  FetchScheduler(const FetchFunction& fetch, const ActivateFunction& activate,
+                 const Options& options);
+
+  // Notify subscriber after each activation.
+  void Subscribe(const Subscriber& subscriber);
+
+  // Schedule the first fetch and, with kActivateOnNextLaunch, activate the
+  // values fetched while the app last ran.  Call once subscribers are added.
+  void Start();
+
+  // Start a fetch if one is due and, with kActivateImmediately, activate
+  // fetched values.  Never blocks.  Returns true if values were activated.
+  bool Update();
+
+  // Activate fetched values if the policy is kActivateAtSafePoint.  Returns
+  // true if values were activated.
+  bool SafePoint();
+
+  // Fetch on the next call to Update(), unless throttled or a fetch is in
+  // flight.
+  void FetchSoon();
+
+  Metrics GetMetrics() const;
+  void LogMetrics() const;
+
+ private:
+  void OnComplete(const FetchResult& result);
+  bool Activate();
+  // Return delay_ms randomly varied by the jitter.  Must be called with
+  // mutex_ held.
+  int64_t Jitter(int64_t delay_ms);
+
+  const FetchFunction fetch_;
+  const ActivateFunction activate_;
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  std::mt19937 random_;
+  std::vector<Subscriber> subscribers_;
+  bool in_flight_;
+  bool fetched_;
+  int consecutive_failures_;
+  int64_t next_fetch_ms_;
+  // Earliest time a fetch is allowed, following a throttled fetch.
+  int64_t throttled_until_ms_;
+  int64_t fetch_start_ms_;
+  int64_t last_success_ms_;
+  Metrics metrics_;
+};
+
+#endif  // FIREBASE_TESTAPP_FETCH_SCHEDULER_H_  // NOLINT
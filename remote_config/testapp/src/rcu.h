@@ -0,0 +1,215 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_RCU_H_  // NOLINT
+#define FIREBASE_TESTAPP_RCU_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Read-copy-update holder for an immutable value read by many threads.
+//
+// Each reading thread creates a Reader once, then reads the current value
+// within a ReadLock.  Taking a ReadLock is wait-free: it records the current
+// epoch in the reader's own slot and loads the value pointer, without
+// writing to memory shared with other readers, so reads scale with the
+// number of cores.
+//
+// Publish() replaces the value and advances the epoch.  The previous value
+// is retired rather than freed, and released once every reader that could
+// have loaded it has left its ReadLock, which is checked on each Publish()
+// and Reclaim().
+//
+// Example:
+//   Rcu<Config> config(initial);
+//   // On each worker thread:
+//   Rcu<Config>::Reader reader(&config);
+//   while (running) {
+//     Rcu<Config>::ReadLock lock(&reader);
+//     Use(lock->value);
+//   }
+//   // On the thread applying changes:
+//   config.Publish(std::make_shared<const Config>(updated));
+template <typename T>
+class Rcu {
+ private:
+  struct Slot;
+
+ public:
+  class Reader;
+
+  // Makes the current value available until destroyed.  ReadLocks on the
+  // same Reader can be nested, and return the same value as the outermost.
+  class ReadLock {
+   public:
+    explicit ReadLock(Reader* reader)
+        : reader_(reader), value_(reader->Lock()) {}
+    ~ReadLock() { reader_->Unlock(); }
+
+    const T* get() const { return value_; }
+    const T& operator*() const { return *value_; }
+    const T* operator->() const { return value_; }
+
+   private:
+    ReadLock(const ReadLock&);
+    ReadLock& operator=(const ReadLock&);
+
+    Reader* reader_;
+    const T* value_;
+  };
+
+  // A thread's registration with the holder.  Each Reader must only be used
+  // by one thread at a time, and must be destroyed before the holder.
+  class Reader {
+   public:
+    explicit Reader(Rcu* rcu)
+        : rcu_(rcu),
+          storage_(new char[sizeof(Slot) + kCacheLineSize - 1]),
+          depth_(0),
+          value_(nullptr) {
+      // Before C++17 new doesn't respect Slot's alignment, so the slot is
+      // aligned within a larger buffer.
+      void* aligned = storage_;
+      size_t space = sizeof(Slot) + kCacheLineSize - 1;
+      slot_ = new (std::align(kCacheLineSize, sizeof(Slot), aligned, space))
+          Slot();
+      rcu_->Register(slot_);
+    }
+    ~Reader() {
+      rcu_->Unregister(slot_);
+      slot_->~Slot();
+      delete[] storage_;
+    }
+
+   private:
+    friend class ReadLock;
+
+    Reader(const Reader&);
+    Reader& operator=(const Reader&);
+
+    const T* Lock() {
+      if (depth_++ == 0) {
+        // The epoch must be visible to Publish() before the value is loaded,
+        // hence the sequentially consistent store and load.
+        slot_->epoch.store(rcu_->epoch_.load(std::memory_order_acquire));
+        value_ = rcu_->current_.load();
+      }
+      return value_;
+    }
+    void Unlock() {
+      if (--depth_ == 0) {
+        slot_->epoch.store(kIdle, std::memory_order_release);
+      }
+    }
+
+    Rcu* rcu_;
+    char* storage_;
+    Slot* slot_;
+    int depth_;
+    // Value loaded by the outermost ReadLock.
+    const T* value_;
+  };
+
+  explicit Rcu(std::shared_ptr<const T> value)
+      : current_(value.get()), epoch_(1), owner_(std::move(value)) {}
+
+  // Replace the value.  Readers that already hold a ReadLock keep the
+  // previous value until they release it.
+  void Publish(std::shared_ptr<const T> value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_.store(value.get());
+    const uint64_t epoch = epoch_.fetch_add(1) + 1;
+    // Readers that loaded the previous value recorded an earlier epoch.
+    retired_.push_back(std::make_pair(epoch, std::move(owner_)));
+    owner_ = std::move(value);
+    ReclaimLocked();
+  }
+
+  // Release retired values no reader can still be using.  Returns the
+  // number still waiting for readers.
+  size_t Reclaim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ReclaimLocked();
+    return retired_.size();
+  }
+
+  // The current value, for threads without a Reader.  Not wait-free.
+  std::shared_ptr<const T> Get() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return owner_;
+  }
+
+ private:
+  // Epoch recorded by readers outside a ReadLock.
+  static const uint64_t kIdle = ~static_cast<uint64_t>(0);
+  static const size_t kCacheLineSize = 64;
+
+  // Epoch a reader entered its ReadLock in, or kIdle.  Aligned to a cache
+  // line so readers don't contend with each other.
+  struct alignas(kCacheLineSize) Slot {
+    Slot() : epoch(kIdle) {}
+
+    std::atomic<uint64_t> epoch;
+  };
+
+  void Register(Slot* slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.push_back(slot);
+  }
+  void Unregister(Slot* slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.erase(std::find(slots_.begin(), slots_.end(), slot));
+  }
+
+  // Must be called with mutex_ held.
+  void ReclaimLocked() {
+    uint64_t oldest = kIdle;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      oldest = std::min(oldest, slots_[i]->epoch.load());
+    }
+    // A value retired at epoch e is only reachable by readers that entered
+    // before e.
+    size_t kept = 0;
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      if (retired_[i].first > oldest) {
+        retired_[kept++] = std::move(retired_[i]);
+      }
+    }
+    retired_.resize(kept);
+  }
+
+  Rcu(const Rcu&);
+  Rcu& operator=(const Rcu&);
+
+  // Read by every reader, so kept apart from the writer's state.
+  std::atomic<const T*> current_;
+  std::atomic<uint64_t> epoch_;
+  char padding_[kCacheLineSize];
+
+  mutable std::mutex mutex_;
+  std::shared_ptr<const T> owner_;
+  std::vector<Slot*> slots_;
+  // Values replaced by Publish() with the epoch they were retired in.
+  std::vector<std::pair<uint64_t, std::shared_ptr<const T>>> retired_;
+};
+
+#endif  // FIREBASE_TESTAPP_RCU_H_  // NOLINT